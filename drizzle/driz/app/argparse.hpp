@@ -1,17 +1,11 @@
 #pragma once
 
-#include "driz/simulation/settings.hpp"
-#include <optional>
+#include "driz/simulation/arguments.hpp"
 
 namespace Driz
 {
-struct ParseResult
+struct ParseResult : SimulationArguments
 {
-    SimulationSettings Settings;
-    std::optional<SimulationState<D2>> State2;
-    std::optional<SimulationState<D3>> State3;
-
-    Dimension Dim;
     f32 RunTime;
     bool Intro;
     bool HasRunTime;
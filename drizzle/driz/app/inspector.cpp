@@ -42,8 +42,8 @@ template <Dimension D> void Inspector<D>::Render() noexcept
     else
     {
         const LookupMethod<D> &lookup = m_Solver->Lookup;
-        m_Data = m_Solver->Data;
-        m_Grid = lookup.Grid;
+        m_Data = m_Solver->Data.Clone();
+        m_Grid = lookup.Grid.Clone();
         m_LookupRadius = lookup.Radius;
 
         renderGridData();
@@ -56,8 +56,8 @@ template <Dimension D> void Inspector<D>::Inspect() noexcept
     m_WantsToInspect = false;
     const LookupMethod<D> &lookup = m_Solver->Lookup;
 
-    m_Data = m_Solver->Data;
-    m_Grid = lookup.Grid;
+    m_Data = m_Solver->Data.Clone();
+    m_Grid = lookup.Grid.Clone();
     m_LookupRadius = lookup.Radius;
 
     m_PairWiseST = InspectionData{};
@@ -112,7 +112,7 @@ template <Dimension D> void Inspector<D>::renderParticle(const u32 p_Index) cons
     const ivec<D> cellPosition = LookupMethod<D>::GetCellPosition(pos, m_LookupRadius);
     const u32 cellKey = LookupMethod<D>::GetCellKey(cellPosition, m_Data.State.Positions.size());
 
-    ImGui::Text("Particle %u", p_Index);
+    ImGui::Text("Particle %u (id %u)", p_Index, m_Data.Ids[p_Index]);
     ImGui::Indent(15.f);
     ImGui::Text("Density: %.2f", densities.x);
     if constexpr (D == D2)
@@ -27,13 +27,13 @@ IntroLayer::IntroLayer(Onyx::Application *p_Application, const SimulationSetting
     if constexpr (D == D2)
     {
         m_Dim = 0;
-        m_State2 = p_State;
+        m_State2 = p_State.Clone();
         updateStateAsLattice(m_State3);
     }
     else
     {
         m_Dim = 1;
-        m_State3 = p_State;
+        m_State3 = p_State.Clone();
         updateStateAsLattice(m_State2);
     }
     m_Window = m_Application->GetMainWindow();
@@ -162,27 +162,11 @@ void IntroLayer::renderIntroSettings() noexcept
 template <Dimension D> void IntroLayer::updateStateAsLattice(SimulationState<D> &p_State) noexcept
 {
     p_State.Positions.clear();
-    p_State.Velocities.clear();
     const f32 separation = 0.4f * m_Settings.SmoothingRadius;
-    const fvec<D> midPoint = 0.5f * separation * fvec<D>{m_Dimensions};
-    for (i32 i = 0; i < m_Dimensions.x; ++i)
-        for (i32 j = 0; j < m_Dimensions.y; ++j)
-            if constexpr (D == D2)
-            {
-                const f32 x = static_cast<f32>(i) * separation;
-                const f32 y = static_cast<f32>(j) * separation;
-                p_State.Positions.push_back(fvec2{x, y} - midPoint);
-                p_State.Velocities.push_back(fvec2{0.f});
-            }
-            else
-                for (i32 k = 0; k < m_Dimensions.z; ++k)
-                {
-                    const f32 x = static_cast<f32>(i) * separation;
-                    const f32 y = static_cast<f32>(j) * separation;
-                    const f32 z = static_cast<f32>(k) * separation;
-                    p_State.Positions.push_back(fvec3{x, y, z} - midPoint);
-                    p_State.Velocities.push_back(fvec3{0.f});
-                }
+    const uvec<D> counts{m_Dimensions};
+    const fvec<D> midPoint = 0.5f * separation * fvec<D>{counts};
+    GenerateLattice<D>(counts, separation, -midPoint, p_State.Positions);
+    p_State.Velocities.assign(p_State.Positions.size(), fvec<D>{0.f});
 }
 
 template <Dimension D> void IntroLayer::renderBoundingBox(SimulationState<D> &p_State) noexcept
@@ -14,36 +14,110 @@ SimLayer<D>::SimLayer(Onyx::Application *p_Application, const SimulationSettings
 {
     m_Window = m_Application->GetMainWindow();
     m_Context = m_Window->GetRenderContext<D>();
+    m_SpawnShape.Spacing = 0.4f * p_Settings.SmoothingRadius;
 }
 
 template <Dimension D> void SimLayer<D>::OnUpdate() noexcept
 {
     TKIT_PROFILE_NSCOPE("SimLayer::Onupdate");
-    if (Onyx::Input::IsKeyPressed(m_Window, Onyx::Input::Key::Space) && !ImGui::GetIO().WantCaptureKeyboard)
+    const bool spawn =
+        Onyx::Input::IsKeyPressed(m_Window, Onyx::Input::Key::Space) && !ImGui::GetIO().WantCaptureKeyboard;
+    if (m_SimulationThread.IsRunning())
+    {
+        if (spawn)
+            pushCommand({.Type = SimulationCommandType::AddParticle, .Position = m_Context->GetMouseCoordinates()});
+        pushSimulationInput();
+        m_Snapshot = &m_SimulationThread.AcquireSnapshot();
+        return;
+    }
+
+    if (spawn)
         m_Solver.AddParticle(m_Context->GetMouseCoordinates());
     if (!m_Pause)
         step(m_DummyStep);
 }
 
+template <Dimension D> void SimLayer<D>::pushSimulationInput() noexcept
+{
+    // The cached input is only updated once a push goes through, so a push that found the queue full is retried on
+    // the next frame. The mouse position is only read while the button is pressed
+    const bool pressed = Onyx::Input::IsMouseButtonPressed(m_Window, Onyx::Input::Mouse::ButtonLeft);
+    const fvec<D> mouse = m_Context->GetMouseCoordinates();
+    if ((pressed != m_PushedMousePressed || (pressed && mouse != m_PushedMousePosition)) &&
+        pushCommand({.Type = SimulationCommandType::SetMouse, .Position = mouse, .Enabled = pressed}))
+    {
+        m_PushedMousePressed = pressed;
+        m_PushedMousePosition = mouse;
+    }
+    if (m_Timestep != m_PushedTimestep &&
+        pushCommand({.Type = SimulationCommandType::SetFrameTime, .FrameTime = m_Timestep}))
+        m_PushedTimestep = m_Timestep;
+    if (m_Pause != m_PushedPause && pushCommand({.Type = SimulationCommandType::SetPaused, .Enabled = m_Pause}))
+        m_PushedPause = m_Pause;
+    m_SimulationThread.PublishSettings(m_AsyncSettings);
+}
+
+template <Dimension D> bool SimLayer<D>::pushCommand(const SimulationCommand<D> &p_Command) noexcept
+{
+    if (m_SimulationThread.Push(p_Command))
+        return true;
+    ++m_DroppedCommands;
+    return false;
+}
+
+template <Dimension D> void SimLayer<D>::setSimulationThread(const bool p_Enabled) noexcept
+{
+    if (p_Enabled == m_SimulationThread.IsRunning())
+        return;
+    if (p_Enabled)
+    {
+        m_AsyncSettings = m_Solver.Settings;
+        m_SimulationThread.Start(m_Timestep);
+        // Matches the input the thread starts with
+        m_PushedMousePressed = false;
+        m_PushedTimestep = m_Timestep;
+        m_PushedPause = false;
+        m_Snapshot = &m_SimulationThread.AcquireSnapshot();
+    }
+    else
+    {
+        // Settings edited since the last frame are handed over with the rest of the pending input
+        m_SimulationThread.PublishSettings(m_AsyncSettings);
+        m_SimulationThread.Stop();
+        m_Snapshot = nullptr;
+    }
+}
+
+template <Dimension D> SimulationSettings &SimLayer<D>::getSettings() noexcept
+{
+    return m_SimulationThread.IsRunning() ? m_AsyncSettings : m_Solver.Settings;
+}
+
+template <Dimension D> void SimLayer<D>::setBounds(const fvec<D> &p_Min, const fvec<D> &p_Max) noexcept
+{
+    if (m_SimulationThread.IsRunning())
+        pushCommand({.Type = SimulationCommandType::SetBounds, .Position = p_Min, .Max = p_Max});
+    else
+    {
+        m_Solver.Data.State.Min = p_Min;
+        m_Solver.Data.State.Max = p_Max;
+    }
+}
+
 template <Dimension D> void SimLayer<D>::OnRender(const VkCommandBuffer) noexcept
 {
     TKIT_PROFILE_NSCOPE("SimLayer::OnRender");
     Visualization<D>::AdjustRenderingContext(m_Context, m_Application->GetDeltaTime());
-    m_Solver.DrawParticles(m_Context);
-    m_Solver.DrawBoundingBox(m_Context);
+    SimulationSettings &settings = getSettings();
+    const SimulationState<D> &state = m_SimulationThread.IsRunning() ? m_Snapshot->State : m_Solver.Data.State;
+    Visualization<D>::DrawParticles(m_Context, settings, state);
+    Visualization<D>::DrawBoundingBox(m_Context, state.Min, state.Max, Onyx::Color::FromHexadecimal("A6B1E1"));
 
     if (Onyx::Input::IsMouseButtonPressed(m_Window, Onyx::Input::Mouse::ButtonLeft) && !ImGui::GetIO().WantCaptureMouse)
-        Visualization<D>::DrawMouseInfluence(m_Context, 2.f * m_Solver.Settings.MouseRadius, Onyx::Color::ORANGE);
+        Visualization<D>::DrawMouseInfluence(m_Context, 2.f * settings.MouseRadius, Onyx::Color::ORANGE);
 
     if (ImGui::Begin("Simulation settings"))
-    {
-        ExportWidget("Export simulation state", Core::GetStatePath<D>(), m_Solver.Data.State);
-        ImportWidget("Import simulation state", Core::GetStatePath<D>(), m_Solver.Data.State);
-
-        if (ImGui::Button("Back to menu"))
-            m_Application->SetUserLayer<IntroLayer>(m_Application, m_Solver.Settings, m_Solver.Data.State);
-        Visualization<D>::RenderSettings(m_Solver.Settings);
-    }
+        renderSimulationSettings();
     ImGui::End();
 
     if (ImGui::Begin("Visualization settings"))
@@ -51,12 +125,39 @@ template <Dimension D> void SimLayer<D>::OnRender(const VkCommandBuffer) noexcep
     ImGui::End();
 
 #ifdef DRIZ_ENABLE_INSPECTOR
-    if (ImGui::Begin("Simulation inspector"))
+    if (ImGui::Begin("Simulation inspector") && !m_SimulationThread.IsRunning())
         m_Inspector.Render();
     ImGui::End();
 #endif
 }
 
+template <Dimension D> void SimLayer<D>::renderSimulationSettings() noexcept
+{
+    // The solver belongs to the simulation thread while it runs, so only the settings can be edited then
+    if (m_SimulationThread.IsRunning())
+        ImGui::TextWrapped("Stop the simulation thread to import or export states.");
+    else
+    {
+        ExportWidget("Export simulation state", Core::GetStatePath<D>(),
+                     [this]() { return m_Solver.GetOrderedState(); });
+        if (ImportWidget("Import simulation state", Core::GetStatePath<D>(), m_Solver.Data.State))
+            m_Solver.SyncParticleData();
+    }
+
+    if (ImGui::Button("Back to menu"))
+    {
+        setSimulationThread(false);
+        m_Application->SetUserLayer<IntroLayer>(m_Application, m_Solver.Settings, m_Solver.GetOrderedState());
+    }
+    const bool running = m_SimulationThread.IsRunning();
+    Visualization<D>::RenderSettings(getSettings(), !running);
+    if (!running && m_Solver.Settings.TabulatedKernels)
+        ImGui::Text("Kernel table error: %.2e", m_Solver.GetKernelTableError());
+    // The settings can tell when a lookup mode is never colored, but only the solver knows when a dense one gave up
+    if (!running && m_Solver.Settings.SupportsColoring() && m_Solver.IsPairWiseFallback())
+        ImGui::TextWrapped("The box is too large for a dense grid: pair-wise passes are running particle-wise.");
+}
+
 template <Dimension D> bool SimLayer<D>::OnEvent(const Onyx::Event &p_Event) noexcept
 {
     if constexpr (D == D2)
@@ -90,7 +191,15 @@ template <Dimension D> bool SimLayer<D>::OnEvent(const Onyx::Event &p_Event) noe
 
 template <Dimension D> void SimLayer<D>::step(const bool p_Dummy) noexcept
 {
-    m_Solver.BeginStep(m_Timestep);
+    Core::ResetBusyTimes();
+    Core::BeginParallelRegion();
+    m_Solver.Advance(m_Timestep, [this, p_Dummy](const f32 p_DeltaTime) { substep(p_DeltaTime, p_Dummy); });
+    Core::EndParallelRegion();
+}
+
+template <Dimension D> void SimLayer<D>::substep(const f32 p_DeltaTime, const bool p_Dummy) noexcept
+{
+    m_Solver.BeginStep(p_DeltaTime);
     m_Solver.UpdateLookup();
     m_Solver.ComputeDensities();
     m_Solver.AddPressureAndViscosity();
@@ -109,10 +218,18 @@ template <Dimension D> void SimLayer<D>::step(const bool p_Dummy) noexcept
 #endif
 
     if (!p_Dummy)
-        m_Solver.ApplyComputedForces(m_Timestep);
+        m_Solver.ApplyComputedForces(p_DeltaTime);
     m_Solver.EndStep();
 }
 
+template <Dimension D> static void dragVector(const char *p_Name, fvec<D> &p_Vector, const f32 p_Speed) noexcept
+{
+    if constexpr (D == D2)
+        ImGui::DragFloat2(p_Name, glm::value_ptr(p_Vector), p_Speed);
+    else
+        ImGui::DragFloat3(p_Name, glm::value_ptr(p_Vector), p_Speed);
+}
+
 template <Dimension D> void SimLayer<D>::renderVisualizationSettings() noexcept
 {
     PresentModeEditor(m_Window);
@@ -120,8 +237,17 @@ template <Dimension D> void SimLayer<D>::renderVisualizationSettings() noexcept
     const u32 fps = static_cast<u32>(1.f / m_Application->GetDeltaTime().AsSeconds());
     ImGui::Text("FPS: %u", fps);
 
-    const u32 pcount = m_Solver.GetParticleCount();
-    ImGui::Text("Particles: %u", pcount);
+    const bool running = m_SimulationThread.IsRunning();
+    bool async = running;
+    if (ImGui::Checkbox("Simulation thread", &async))
+        setSimulationThread(async);
+    if (running)
+        ImGui::Text("Simulation frame time: %.2f ms", m_Snapshot->StepTime * 1000.f);
+    if (m_DroppedCommands > 0)
+        ImGui::Text("Dropped commands: %u (the simulation thread fell behind)", m_DroppedCommands);
+
+    const SimulationState<D> &state = running ? m_Snapshot->State : m_Solver.Data.State;
+    ImGui::Text("Particles: %u", state.Positions.size());
 
     static bool syncTimestep = false;
     ImGui::Checkbox("Sync Timestep", &syncTimestep);
@@ -141,34 +267,111 @@ template <Dimension D> void SimLayer<D>::renderVisualizationSettings() noexcept
         ImGui::Text("(%.4f)", m_Timestep);
     }
 
+    SimulationSettings &settings = getSettings();
+    ImGui::Checkbox("Adaptive timestep", &settings.AdaptiveTimestep);
+    if (settings.AdaptiveTimestep)
+    {
+        ImGui::DragFloat("Courant number", &settings.CourantNumber, 0.005f, 0.01f, 1.f);
+        ImGui::DragFloat("Force number", &settings.ForceNumber, 0.005f, 0.01f, 1.f);
+        i32 substeps = static_cast<i32>(settings.MaxSubsteps);
+        if (ImGui::SliderInt("Max substeps", &substeps, 1, 64))
+            settings.MaxSubsteps = static_cast<u32>(substeps);
+
+        const TimestepStats &stats = running ? m_Snapshot->Stats : m_Solver.GetTimestepStats();
+        ImGui::Text("Substeps: %u (dt %.5f - %.5f)", stats.Substeps, stats.MinDeltaTime, stats.MaxDeltaTime);
+        if (stats.DroppedTime > 0.f)
+            ImGui::Text("Dropped %.2f ms of simulated time", stats.DroppedTime * 1000.f);
+    }
+
+    // Busy times, the grid and manual steps all belong to whichever thread runs the solver
+    if (!running && settings.UsesMultiThread() && ImGui::TreeNode("Thread busy time"))
+    {
+        // The busiest thread bounds every pass, so its time against the average is the cost of the imbalance
+        const u32 threads = Core::GetThreadCount();
+        f32 total = 0.f;
+        f32 busiest = 0.f;
+        for (u32 i = 0; i < threads; ++i)
+        {
+            const f32 busy = Core::GetBusyTime(i).AsMilliseconds();
+            ImGui::Text("Thread %u: %.3f ms", i, busy);
+            total += busy;
+            busiest = glm::max(busiest, busy);
+        }
+        if (total > 0.f)
+            ImGui::Text("Imbalance: %.2f", busiest * static_cast<f32>(threads) / total);
+        ImGui::TreePop();
+    }
+
     static bool drawGrid = false;
-    ImGui::Checkbox("Draw grid", &drawGrid);
-    if (m_Solver.Settings.UsesGrid() && drawGrid)
+    if (!running)
+        ImGui::Checkbox("Draw grid", &drawGrid);
+    if (!running && settings.UsesGrid() && drawGrid)
     {
         m_Solver.UpdateLookup();
-        const u32 cellClashes = m_Solver.Lookup.DrawCells(m_Context);
+        const u32 cellClashes = Visualization<D>::DrawCells(m_Context, m_Solver.Lookup);
         ImGui::Text("Cell clashes: %u", cellClashes);
     }
 
     ImGui::Checkbox("Pause simulation", &m_Pause);
-    ImGui::Checkbox("Dummy step", &m_DummyStep);
-    if ((m_Pause || m_DummyStep) && ImGui::Button("Step"))
-        step();
+    if (!running)
+    {
+        ImGui::Checkbox("Dummy step", &m_DummyStep);
+        if ((m_Pause || m_DummyStep) && ImGui::Button("Step"))
+            step();
+    }
 
     if (ImGui::TreeNode("Bounding box"))
     {
-        if (ImGui::DragFloat("Width", &m_Solver.Data.State.Max.x, 0.05f))
-            m_Solver.Data.State.Min.x = -m_Solver.Data.State.Max.x;
-        if (ImGui::DragFloat("Height", &m_Solver.Data.State.Max.y, 0.05f))
-            m_Solver.Data.State.Min.y = -m_Solver.Data.State.Max.y;
+        fvec<D> min = state.Min;
+        fvec<D> max = state.Max;
+        bool changed = false;
+        if (ImGui::DragFloat("Width", &max.x, 0.05f))
+        {
+            min.x = -max.x;
+            changed = true;
+        }
+        if (ImGui::DragFloat("Height", &max.y, 0.05f))
+        {
+            min.y = -max.y;
+            changed = true;
+        }
         if constexpr (D == D3)
         {
-            if (ImGui::DragFloat("Depth", &m_Solver.Data.State.Max.z, 0.05f))
-                m_Solver.Data.State.Min.z = -m_Solver.Data.State.Max.z;
+            if (ImGui::DragFloat("Depth", &max.z, 0.05f))
+            {
+                min.z = -max.z;
+                changed = true;
+            }
         }
+        if (changed)
+            setBounds(min, max);
 
         ImGui::TreePop();
     }
+
+    if (ImGui::TreeNode("Spawn particles"))
+    {
+        i32 type = static_cast<i32>(m_SpawnShape.Type);
+        if (ImGui::Combo("Shape", &type, "Block\0Sphere\0Jet\0\0"))
+            m_SpawnShape.Type = static_cast<ShapeType>(type);
+
+        dragVector<D>("Center", m_SpawnShape.Center, 0.05f);
+        if (m_SpawnShape.Type == ShapeType::Block)
+            dragVector<D>("Half extents", m_SpawnShape.Size, 0.05f);
+        else
+            ImGui::DragFloat("Radius", &m_SpawnShape.Size[0], 0.05f, 0.f, FLT_MAX);
+        dragVector<D>("Velocity", m_SpawnShape.Velocity, 0.05f);
+        ImGui::DragFloat("Spacing", &m_SpawnShape.Spacing, 0.005f, 0.01f, FLT_MAX);
+
+        if (ImGui::Button("Spawn"))
+        {
+            if (running)
+                pushCommand({.Type = SimulationCommandType::AddShape, .Shape = m_SpawnShape});
+            else
+                m_Solver.AddParticles(m_SpawnShape);
+        }
+        ImGui::TreePop();
+    }
 }
 
 template class SimLayer<D2>;
@@ -3,7 +3,7 @@
 #include "onyx/app/user_layer.hpp"
 #include "onyx/app/app.hpp"
 #include "onyx/rendering/render_context.hpp"
-#include "driz/simulation/solver.hpp"
+#include "driz/simulation/sim_thread.hpp"
 #include "driz/app/inspector.hpp"
 
 namespace Driz
@@ -20,6 +20,17 @@ template <Dimension D> class SimLayer final : public Onyx::UserLayer
     bool OnEvent(const Onyx::Event &p_Event) noexcept override;
 
     void step(bool p_Dummy = false) noexcept;
+    void substep(f32 p_DeltaTime, bool p_Dummy) noexcept;
+
+    void setSimulationThread(bool p_Enabled) noexcept;
+    void pushSimulationInput() noexcept;
+    // Counts the command as dropped and returns false if the simulation thread's queue is full
+    bool pushCommand(const SimulationCommand<D> &p_Command) noexcept;
+    // The settings the UI edits: the solver's own, or a copy published every frame while the simulation thread runs
+    SimulationSettings &getSettings() noexcept;
+    void setBounds(const fvec<D> &p_Min, const fvec<D> &p_Max) noexcept;
+
+    void renderSimulationSettings() noexcept;
     void renderVisualizationSettings() noexcept;
 
     Onyx::Application *m_Application;
@@ -29,8 +40,20 @@ template <Dimension D> class SimLayer final : public Onyx::UserLayer
 #ifdef DRIZ_ENABLE_INSPECTOR
     Inspector<D> m_Inspector{&m_Solver};
 #endif
+    // Declared after the solver, so that the thread is stopped before the solver goes away
+    SimulationThread<D> m_SimulationThread{&m_Solver};
+    SimulationSettings m_AsyncSettings{};
+    const SimulationSnapshot<D> *m_Snapshot = nullptr;
     Onyx::RenderContext<D> *m_Context;
 
+    // Input last accepted by the simulation thread, so that it is only pushed again once it changes
+    fvec<D> m_PushedMousePosition{0.f};
+    f32 m_PushedTimestep = 0.f;
+    u32 m_DroppedCommands = 0;
+    bool m_PushedMousePressed = false;
+    bool m_PushedPause = false;
+
+    ParticleShape<D> m_SpawnShape{};
     f32 m_Timestep = 1.f / 60.f;
     bool m_DummyStep = false;
     bool m_Pause = false;
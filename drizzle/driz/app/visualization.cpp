@@ -1,5 +1,6 @@
 #include "driz/app/visualization.hpp"
 #include "driz/simulation/solver.hpp"
+#include "tkit/profiling/macros.hpp"
 
 namespace Driz
 {
@@ -25,7 +26,10 @@ void Visualization<D>::DrawParticles(Onyx::RenderContext<D> *p_Context, const Si
 {
     const f32 psize = 2.f * p_Settings.ParticleRadius;
 
-    const Onyx::Gradient gradient{p_Settings.Gradient};
+    TKit::Array<Onyx::Color, 3> colors;
+    for (u32 i = 0; i < colors.size(); ++i)
+        colors[i] = Onyx::Color{p_Settings.Gradient[i]};
+    const Onyx::Gradient gradient{colors};
     for (u32 i = 0; i < p_State.Positions.size(); ++i)
     {
         const fvec<D> &pos = p_State.Positions[i];
@@ -160,13 +164,92 @@ void Visualization<D>::DrawCell(Onyx::RenderContext<D> *p_Context, const ivec<D>
     }
 }
 
+template <Dimension D>
+u32 Visualization<D>::DrawCells(Onyx::RenderContext<D> *p_Context, const LookupMethod<D> &p_Lookup) noexcept
+{
+    TKIT_PROFILE_NSCOPE("Driz::Visualization::DrawCells");
+    const auto isUnique = [](const auto it1, const auto it2, const ivec<D> &p_Position) {
+        for (auto it = it1; it != it2; ++it)
+            if (*it == p_Position)
+                return false;
+        return true;
+    };
+
+    const auto &positions = p_Lookup.GetPositions();
+    const f32 cellSize = p_Lookup.GetCellSize();
+
+    u32 cellClashes = 0;
+    for (const GridCell &cell : p_Lookup.Grid.Cells)
+    {
+        TKit::Array<ivec<D>, 16> uniquePositions;
+        u32 uniqueSize = 0;
+        for (u32 i = cell.Start; i < cell.End; ++i)
+        {
+            const u32 index = p_Lookup.Grid.ParticleIndices[i];
+            const ivec<D> cellPosition = p_Lookup.GetCellPosition(positions[index]);
+            if (isUnique(uniquePositions.begin(), uniquePositions.begin() + uniqueSize, cellPosition))
+                uniquePositions[uniqueSize++] = cellPosition;
+        }
+
+        const Onyx::Color color = uniqueSize == 1 ? Onyx::Color::WHITE : Onyx::Color::RED;
+        DrawCell(p_Context, uniquePositions[0], cellSize, color, 0.04f);
+        cellClashes += uniqueSize - 1;
+
+        for (u32 i = 1; i < uniqueSize; ++i)
+        {
+            DrawCell(p_Context, uniquePositions[i], cellSize, color, 0.04f);
+            const fvec<D> pos1 = fvec<D>{uniquePositions[i - 1]} + 0.5f * cellSize;
+            const fvec<D> pos2 = fvec<D>{uniquePositions[i]} + 0.5f * cellSize;
+
+            p_Context->Fill(Onyx::Color::YELLOW);
+            p_Context->Line(pos1, pos2, 0.08f);
+        }
+    }
+    return cellClashes;
+}
+
 static void comboKenel(const char *name, KernelType &p_Type) noexcept
 {
     ImGui::Combo(name, reinterpret_cast<i32 *>(&p_Type),
                  "Spiky2\0Spiky3\0Spiky5\0Cubic Spline\0WendlandC2\0WendlandC4\0\0");
 }
 
-template <Dimension D> void Visualization<D>::RenderSettings(SimulationSettings &p_Settings) noexcept
+static void editFlowVolumes(const char *p_Name, TKit::StaticArray<FlowVolume, MaxFlowVolumes> &p_Volumes,
+                            const bool p_Emitter) noexcept
+{
+    if (!ImGui::TreeNode(p_Name))
+        return;
+
+    const f32 speed = 0.2f;
+    for (u32 i = 0; i < p_Volumes.size(); ++i)
+    {
+        ImGui::PushID(static_cast<i32>(i));
+        FlowVolume &volume = p_Volumes[i];
+        ImGui::Checkbox("Enabled", &volume.Enabled);
+        ImGui::DragFloat3("Min", glm::value_ptr(volume.Min), speed);
+        ImGui::DragFloat3("Max", glm::value_ptr(volume.Max), speed);
+        if (p_Emitter)
+        {
+            ImGui::DragFloat3("Velocity", glm::value_ptr(volume.Velocity), speed);
+            ImGui::DragFloat("Rate", &volume.Rate, speed * 10.f, 0.f, FLT_MAX, "%.1f particles/s");
+        }
+        const bool remove = ImGui::Button("Remove");
+        ImGui::PopID();
+        if (remove)
+        {
+            for (u32 j = i + 1; j < p_Volumes.size(); ++j)
+                p_Volumes[j - 1] = p_Volumes[j];
+            p_Volumes.pop_back();
+            break;
+        }
+    }
+    if (p_Volumes.size() < MaxFlowVolumes && ImGui::Button("Add"))
+        p_Volumes.push_back(FlowVolume{});
+    ImGui::TreePop();
+}
+
+template <Dimension D>
+void Visualization<D>::RenderSettings(SimulationSettings &p_Settings, const bool p_EditThreading) noexcept
 {
     const f32 speed = 0.2f;
     ImGui::TextWrapped(
@@ -207,20 +290,48 @@ template <Dimension D> void Visualization<D>::RenderSettings(SimulationSettings
     ImGui::Text("Environment settings:");
     ImGui::DragFloat("Gravity", &p_Settings.Gravity, speed);
     ImGui::DragFloat("Encase Friction", &p_Settings.EncaseFriction, speed);
+    ImGui::TextWrapped("Emitters spawn particles at random positions inside their box, and sinks remove the ones "
+                       "that enter theirs. The z axis is ignored in 2D.");
+    editFlowVolumes("Emitters", p_Settings.Emitters, true);
+    editFlowVolumes("Sinks", p_Settings.Sinks, false);
 
     ImGui::Text("Kernel settings:");
     comboKenel("Smooth radius kernel", p_Settings.KType);
     comboKenel("Near pressure/density kernel", p_Settings.NearKType);
+    ImGui::Checkbox("Tabulated kernels", &p_Settings.TabulatedKernels);
 
     ImGui::Text("Optimizations:");
     ImGui::Combo("Lookup mode", reinterpret_cast<i32 *>(&p_Settings.LookupMode),
-                 "Brute Force SingleThread\0Brute Force MultiTread\0Grid SingleTread\0Grid MultiTread\0\0");
+                 "Brute Force SingleThread\0Brute Force MultiTread\0Grid SingleTread\0Grid MultiTread\0"
+                 "Dense Grid SingleThread\0Dense Grid MultiThread\0"
+                 "Verlet List SingleThread\0Verlet List MultiThread\0\0");
     ImGui::Combo("Iteration mode", reinterpret_cast<i32 *>(&p_Settings.IterationMode), "Pairwise\0Particlewise\0\0");
-    if (p_Settings.UsesMultiThread())
+    if (p_Settings.IterationMode == ParticleIterationMode::PairWise && p_Settings.UsesMultiThread() &&
+        !p_Settings.SupportsColoring())
+        ImGui::TextWrapped("This lookup mode cannot be colored: pair-wise passes run particle-wise, which evaluates "
+                           "every kernel twice. Pick a dense grid or Verlet list mode to run them pair-wise.");
+    if (p_Settings.IterationMode == ParticleIterationMode::PairWise)
+        ImGui::Checkbox("Cache pairs", &p_Settings.CachePairs);
+    if (p_Settings.UsesGrid())
+    {
+        i32 interval = static_cast<i32>(p_Settings.ReorderInterval);
+        if (ImGui::SliderInt("Reorder interval", &interval, 0, 120))
+            p_Settings.ReorderInterval = static_cast<u32>(interval);
+    }
+    if (p_Settings.UsesNeighborLists())
+        ImGui::DragFloat("Verlet skin", &p_Settings.VerletSkin, speed * 0.1f, 0.f, FLT_MAX);
+    if (p_Settings.UsesMultiThread() && p_EditThreading)
     {
-        i32 threads = static_cast<i32>(Core::GetThreadPool().GetThreadCount());
-        if (ImGui::SliderInt("Worker thread count", &threads, 0, 15))
+        i32 threads = static_cast<i32>(Core::GetWorkerThreadCount());
+        if (ImGui::SliderInt("Worker thread count", &threads, 0, static_cast<i32>(Core::GetMaxWorkerThreadCount())))
             Core::SetWorkerThreadCount(static_cast<u32>(threads));
+
+        const CpuTopology &topology = Core::GetCpuTopology();
+        ImGui::Text("%u physical cores (%u performance), %u logical, %u NUMA nodes", topology.PhysicalCores,
+                    topology.PerformanceCores, topology.LogicalCores, topology.NumaNodes);
+        bool team = Core::IsWorkerTeamEnabled();
+        if (ImGui::Checkbox("Persistent worker team", &team))
+            Core::SetWorkerTeamEnabled(team);
     }
 }
 
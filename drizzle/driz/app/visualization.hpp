@@ -1,11 +1,13 @@
 #pragma once
 
 #include "driz/core/glm.hpp"
+#include "driz/simulation/lookup.hpp"
 #include "onyx/rendering/render_context.hpp"
-#include "onyx/serialization/color.hpp"
 #include "tkit/profiling/timespan.hpp"
 #include "tkit/reflection/driz/simulation/settings.hpp"
+#include "driz/core/serialization.hpp"
 #include "tkit/serialization/yaml/container.hpp"
+#include "tkit/serialization/yaml/glm.hpp"
 #include <imgui.h>
 
 namespace Driz
@@ -25,8 +27,12 @@ template <Dimension D> struct Visualization
 
     static void DrawCell(Onyx::RenderContext<D> *p_Context, const ivec<D> &p_Position, f32 p_Size,
                          const Onyx::Color &p_Color, f32 p_Thickness = 0.1f) noexcept;
+    // Draws every grid cell, highlighting the ones shared by particles from different cells because of a hash
+    // collision. Returns the amount of such collisions
+    static u32 DrawCells(Onyx::RenderContext<D> *p_Context, const LookupMethod<D> &p_Lookup) noexcept;
 
-    static void RenderSettings(SimulationSettings &p_Settings) noexcept;
+    // Worker thread controls are only shown if p_EditThreading is true, as they must not change while a pass may run
+    static void RenderSettings(SimulationSettings &p_Settings, bool p_EditThreading = true) noexcept;
 };
 
 template <typename T> void ExportWidget(const char *p_Name, const fs::path &p_DirPath, const T &p_Instance) noexcept
@@ -38,13 +44,18 @@ template <typename T> void ExportWidget(const char *p_Name, const fs::path &p_Di
         if (path.extension().empty())
             path += ".yaml";
 
-        TKit::Yaml::Serialize(path.c_str(), p_Instance);
+        // Instances that are expensive to produce may be passed as a getter, so they are only built on export
+        if constexpr (std::is_invocable_v<const T &>)
+            TKit::Yaml::Serialize(path.c_str(), p_Instance());
+        else
+            TKit::Yaml::Serialize(path.c_str(), p_Instance);
         xport[0] = '\0';
     }
 }
 
-template <typename T> void ImportWidget(const char *p_Name, const fs::path &p_DirPath, T &p_Instance) noexcept
+template <typename T> bool ImportWidget(const char *p_Name, const fs::path &p_DirPath, T &p_Instance) noexcept
 {
+    bool imported = false;
     TKit::StaticArray32<fs::path> paths;
     for (const auto &entry : fs::directory_iterator(p_DirPath))
         paths.push_back(entry.path());
@@ -58,13 +69,17 @@ template <typename T> void ImportWidget(const char *p_Name, const fs::path &p_Di
             const bool erase = ImGui::Button("X");
             ImGui::SameLine();
             if (ImGui::MenuItem(filename.c_str()))
+            {
                 p_Instance = TKit::Yaml::Deserialize<T>(path.c_str());
+                imported = true;
+            }
 
             if (erase)
                 fs::remove(path);
         }
         ImGui::EndMenu();
     }
+    return imported;
 }
 
 } // namespace Driz
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "driz/bench/benchmark.hpp"
+#include "driz/core/report.hpp"
+#include <iostream>
+
+namespace Driz
+{
+void BenchmarkParameters::addKey(const char *p_Name) noexcept
+{
+    m_Json.pop_back();
+    if (m_Json.size() > 1)
+        m_Json += ", ";
+    m_Json += '"';
+    m_Json += p_Name;
+    m_Json += "\": ";
+}
+
+BenchmarkParameters &BenchmarkParameters::Add(const char *p_Name, const u64 p_Value) noexcept
+{
+    addKey(p_Name);
+    m_Json += std::to_string(p_Value);
+    m_Json += '}';
+    return *this;
+}
+BenchmarkParameters &BenchmarkParameters::Add(const char *p_Name, const char *p_Value) noexcept
+{
+    addKey(p_Name);
+    m_Json += '"';
+    m_Json += p_Value;
+    m_Json += "\"}";
+    return *this;
+}
+
+BenchmarkRunner::BenchmarkRunner(const f64 p_MinSeconds, std::string p_Filter) noexcept
+    : m_Filter(std::move(p_Filter)), m_MinNs(p_MinSeconds * 1e9)
+{
+}
+
+bool BenchmarkRunner::IsEnabled(const std::string &p_Name) const noexcept
+{
+    return m_Filter.empty() || p_Name.find(m_Filter) != std::string::npos;
+}
+
+void BenchmarkRunner::record(const std::string &p_Name, const BenchmarkParameters &p_Parameters, const u64 p_Items,
+                             TKit::DynamicArray<f64> &p_Samples) noexcept
+{
+    const SampleStatistics stats = ComputeStatistics(p_Samples);
+
+    // Progress goes to stderr, so that stdout can be redirected to a file with the results alone
+    std::cerr << p_Name << ' ' << p_Parameters.ToJson() << ": " << stats.Median / 1e6 << " ms" << std::endl;
+    m_Results.push_back(BenchmarkResult{p_Name, p_Parameters, stats.Count, p_Items, stats.Mean, stats.Median,
+                                        stats.Min, stats.StdDev});
+}
+
+void BenchmarkRunner::WriteJson(std::ostream &p_Stream) const noexcept
+{
+    p_Stream << "{\n  ";
+    WriteReportContext(p_Stream);
+    p_Stream << ",\n  \"benchmarks\": [";
+
+    for (u32 i = 0; i < m_Results.size(); ++i)
+    {
+        const BenchmarkResult &result = m_Results[i];
+        p_Stream << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << result.Name
+                 << "\", \"parameters\": " << result.Parameters.ToJson() << ", \"iterations\": " << result.Iterations
+                 << ", \"items\": " << result.Items << ", \"mean_ns\": " << result.MeanNs
+                 << ", \"median_ns\": " << result.MedianNs << ", \"min_ns\": " << result.MinNs
+                 << ", \"stddev_ns\": " << result.StdDevNs
+                 << ", \"ns_per_item\": " << result.MedianNs / static_cast<f64>(result.Items) << "}";
+    }
+    p_Stream << "\n  ]\n}" << std::endl;
+}
+} // namespace Driz
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "driz/core/alias.hpp"
+#include <chrono>
+#include <iosfwd>
+#include <string>
+
+namespace Driz
+{
+// Keeps the compiler from discarding a value that is computed only to be measured
+template <typename T> void DoNotOptimize(const T &p_Value) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(p_Value) : "memory");
+#else
+    static volatile const void *s_Sink;
+    s_Sink = &p_Value;
+#endif
+}
+
+// Named values describing a measurement, written as a JSON object
+class BenchmarkParameters
+{
+  public:
+    BenchmarkParameters &Add(const char *p_Name, u64 p_Value) noexcept;
+    BenchmarkParameters &Add(const char *p_Name, const char *p_Value) noexcept;
+
+    const std::string &ToJson() const noexcept
+    {
+        return m_Json;
+    }
+
+  private:
+    void addKey(const char *p_Name) noexcept;
+
+    std::string m_Json{"{}"};
+};
+
+struct BenchmarkResult
+{
+    std::string Name;
+    BenchmarkParameters Parameters;
+    u32 Iterations;
+    // Work items processed per iteration, such as particles or kernel evaluations
+    u64 Items;
+    f64 MeanNs;
+    f64 MedianNs;
+    f64 MinNs;
+    f64 StdDevNs;
+};
+
+class BenchmarkRunner
+{
+  public:
+    BenchmarkRunner(f64 p_MinSeconds, std::string p_Filter) noexcept;
+
+    bool IsEnabled(const std::string &p_Name) const noexcept;
+
+    // Calls p_Function repeatedly, once to warm up and then until p_MinSeconds have passed, with at least a few
+    // samples. Every call is timed on its own, so p_Function should do enough work to dwarf the clock's resolution
+    template <typename F>
+    void Measure(const std::string &p_Name, const BenchmarkParameters &p_Parameters, const u64 p_Items,
+                 F &&p_Function) noexcept
+    {
+        if (!IsEnabled(p_Name))
+            return;
+
+        using Clock = std::chrono::steady_clock;
+        p_Function();
+
+        TKit::DynamicArray<f64> samples;
+        f64 total = 0.0;
+        while (samples.size() < s_MinSamples || (total < m_MinNs && samples.size() < s_MaxSamples))
+        {
+            const Clock::time_point start = Clock::now();
+            p_Function();
+            const f64 elapsed = std::chrono::duration<f64, std::nano>(Clock::now() - start).count();
+            samples.push_back(elapsed);
+            total += elapsed;
+        }
+        record(p_Name, p_Parameters, p_Items, samples);
+    }
+
+    void WriteJson(std::ostream &p_Stream) const noexcept;
+
+  private:
+    static constexpr u32 s_MinSamples = 3;
+    static constexpr u32 s_MaxSamples = 100000;
+
+    void record(const std::string &p_Name, const BenchmarkParameters &p_Parameters, u64 p_Items,
+                TKit::DynamicArray<f64> &p_Samples) noexcept;
+
+    TKit::DynamicArray<BenchmarkResult> m_Results;
+    std::string m_Filter;
+    f64 m_MinNs;
+};
+} // namespace Driz
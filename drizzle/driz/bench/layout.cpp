@@ -0,0 +1,102 @@
+#include "driz/bench/layout.hpp"
+#include "driz/simulation/shape.hpp"
+#include "driz/core/core.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace Driz
+{
+static constexpr const char *s_LayoutNames[LayoutCount] = {"block", "dam-break", "splash"};
+
+const char *ToString(const Layout p_Layout) noexcept
+{
+    return s_LayoutNames[static_cast<u32>(p_Layout)];
+}
+std::optional<Layout> ParseLayout(const std::string &p_Name) noexcept
+{
+    for (u32 i = 0; i < LayoutCount; ++i)
+        if (p_Name == s_LayoutNames[i])
+            return static_cast<Layout>(i);
+    return std::nullopt;
+}
+
+// Appends p_Count particles on a lattice filling a box of the given aspect, with its lower corner at p_Origin
+template <Dimension D>
+static void addLattice(SimArray<fvec<D>> &p_Positions, const u32 p_Count, const fvec<D> &p_Aspect,
+                       const fvec<D> &p_Origin, const f32 p_Spacing) noexcept
+{
+    f32 volume = 1.f;
+    for (u32 i = 0; i < D; ++i)
+        volume *= p_Aspect[i];
+    const f32 scale = std::pow(static_cast<f32>(p_Count) / volume, 1.f / static_cast<f32>(D));
+
+    uvec<D> counts;
+    for (u32 i = 0; i < D; ++i)
+        counts[i] = glm::max(static_cast<u32>(std::ceil(scale * p_Aspect[i])), 1u);
+
+    // The lattice may hold a few more points than requested, which are dropped from its last layer
+    const u32 start = p_Positions.size();
+    GenerateLattice<D>(counts, p_Spacing, p_Origin, p_Positions);
+    p_Positions.resize(start + p_Count);
+}
+
+template <Dimension D>
+SimulationState<D> CreateLayoutState(const Layout p_Layout, const u32 p_Particles,
+                                     const SimulationSettings &p_Settings) noexcept
+{
+    const f32 spacing = 0.4f * p_Settings.SmoothingRadius;
+    const f32 side = spacing * std::pow(static_cast<f32>(p_Particles), 1.f / static_cast<f32>(D));
+
+    SimulationState<D> state{};
+    switch (p_Layout)
+    {
+    case Layout::Block:
+        state.Min = fvec<D>{-0.5f * side - spacing};
+        state.Max = fvec<D>{0.5f * side + spacing};
+        addLattice<D>(state.Positions, p_Particles, fvec<D>{1.f}, state.Min + 0.5f * spacing, spacing);
+        break;
+    case Layout::DamBreak: {
+        fvec<D> aspect{1.f};
+        aspect.x = 0.5f;
+        state.Min = fvec<D>{-side};
+        state.Max = fvec<D>{side};
+        state.Max.x = 2.f * side;
+        addLattice<D>(state.Positions, p_Particles, aspect, state.Min + 0.5f * spacing, spacing);
+        break;
+    }
+    case Layout::Splash: {
+        fvec<D> aspect{4.f};
+        aspect.y = 1.f;
+        state.Min = fvec<D>{-side};
+        state.Max = fvec<D>{side};
+        const u32 pool = p_Particles - p_Particles / 4;
+        addLattice<D>(state.Positions, pool, aspect, state.Min + 0.5f * spacing, spacing);
+
+        std::minstd_rand random{};
+        std::uniform_real_distribution<f32> unit{0.f, 1.f};
+        for (u32 i = pool; i < p_Particles; ++i)
+        {
+            fvec<D> position;
+            for (u32 j = 0; j < D; ++j)
+                position[j] = state.Min[j] + unit(random) * (state.Max[j] - state.Min[j]);
+            state.Positions.push_back(position);
+        }
+        break;
+    }
+    }
+    state.Velocities.assign(state.Positions.size(), fvec<D>{0.f});
+    return state;
+}
+
+void SetThreadCount(const u32 p_Threads) noexcept
+{
+    // The calling thread always takes part, so a count of zero is treated as one
+    const u32 threads = std::max(p_Threads, 1u);
+    if (Core::GetThreadCount() != threads)
+        Core::SetWorkerThreadCount(threads - 1);
+}
+
+template SimulationState<D2> CreateLayoutState<D2>(Layout, u32, const SimulationSettings &) noexcept;
+template SimulationState<D3> CreateLayoutState<D3>(Layout, u32, const SimulationSettings &) noexcept;
+} // namespace Driz
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "driz/simulation/settings.hpp"
+#include <optional>
+#include <string>
+
+namespace Driz
+{
+// Synthetic particle layouts at rest density spacing. The block fills its whole domain, the dam break occupies a
+// corner of a domain three times as wide, and the splash is a shallow pool with droplets scattered all over
+enum class Layout : u8
+{
+    Block = 0,
+    DamBreak,
+    Splash
+};
+constexpr u32 LayoutCount = 3;
+
+const char *ToString(Layout p_Layout) noexcept;
+std::optional<Layout> ParseLayout(const std::string &p_Name) noexcept;
+
+template <Dimension D>
+SimulationState<D> CreateLayoutState(Layout p_Layout, u32 p_Particles, const SimulationSettings &p_Settings) noexcept;
+
+// Sets the amount of threads taking part in parallel passes, the calling one included. Threads are only recreated if
+// the count changes
+void SetThreadCount(u32 p_Threads) noexcept;
+} // namespace Driz
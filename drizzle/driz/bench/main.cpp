@@ -0,0 +1,351 @@
+#include "driz/bench/benchmark.hpp"
+#include "driz/bench/scaling.hpp"
+#include "driz/simulation/solver.hpp"
+#include <argparse/argparse.hpp>
+#include <fstream>
+#include <iostream>
+
+namespace Driz
+{
+static constexpr const char *s_LookupNames[] = {"brute-force-st", "brute-force-mt", "grid-st",   "grid-mt",
+                                                "dense-grid-st",  "dense-grid-mt",  "verlet-st", "verlet-mt"};
+static constexpr const char *s_IterationNames[] = {"pair-wise", "particle-wise"};
+static constexpr const char *s_KernelNames[] = {"spiky2",       "spiky3",      "spiky5",     "poly6",
+                                                "cubic-spline", "wendland-c2", "wendland-c4"};
+
+struct BenchmarkOptions
+{
+    TKit::DynamicArray<u32> Dimensions;
+    TKit::DynamicArray<u32> ParticleCounts;
+    TKit::DynamicArray<u32> ThreadCounts;
+    TKit::DynamicArray<Layout> Layouts;
+    u32 ModeParticles;
+};
+
+template <Dimension D> static void runKernelBenchmarks(BenchmarkRunner &p_Runner) noexcept
+{
+    constexpr u32 evaluations = 4096;
+    const KernelParameters parameters = Kernel<D>::CreateParameters(1.f);
+    TKit::Array<f32, evaluations> distances;
+    TKit::Array<f32, evaluations> results;
+    for (u32 i = 0; i < evaluations; ++i)
+        distances[i] = (static_cast<f32>(i) + 0.5f) / evaluations;
+
+    for (u32 k = 0; k < KernelTypeCount; ++k)
+    {
+        const KernelType type = static_cast<KernelType>(k);
+        BenchmarkParameters benchParameters{};
+        benchParameters.Add("dim", D).Add("kernel", s_KernelNames[k]);
+
+        p_Runner.Measure("kernel/value", benchParameters, evaluations, [&]() {
+            f32 sum = 0.f;
+            for (const f32 distance : distances)
+                sum += Kernel<D>::Evaluate(type, parameters, distance);
+            DoNotOptimize(sum);
+        });
+        p_Runner.Measure("kernel/slope", benchParameters, evaluations, [&]() {
+            f32 sum = 0.f;
+            for (const f32 distance : distances)
+                sum += Kernel<D>::EvaluateSlope(type, parameters, distance);
+            DoNotOptimize(sum);
+        });
+        p_Runner.Measure("kernel/value-batched", benchParameters, evaluations, [&]() {
+            Kernel<D>::Evaluate(type, parameters, distances.data(), results.data(), evaluations);
+            DoNotOptimize(results);
+        });
+        p_Runner.Measure("kernel/slope-batched", benchParameters, evaluations, [&]() {
+            Kernel<D>::EvaluateSlope(type, parameters, distances.data(), results.data(), evaluations);
+            DoNotOptimize(results);
+        });
+    }
+}
+
+// The lookup passes are measured on their own, on a state that was never stepped
+template <Dimension D>
+static void runLookupBenchmarks(BenchmarkRunner &p_Runner, const BenchmarkParameters &p_Parameters,
+                                const SimulationState<D> &p_State, const SimulationSettings &p_Settings) noexcept
+{
+    const f32 radius = p_Settings.SmoothingRadius;
+    const u32 particles = p_State.Positions.size();
+    LookupMethod<D> lookup{};
+    lookup.SetPositions(&p_State.Positions);
+    Core::BeginParallelRegion();
+
+    // Without a seed order every build runs the radix sort. Clearing keeps the storage, so nothing is allocated
+    p_Runner.Measure("lookup/update-grid", p_Parameters, particles, [&lookup, radius]() {
+        lookup.Grid.ParticleIndices.clear();
+        lookup.UpdateGridLookup(radius, true);
+    });
+    // Seeded by the previous build on positions that did not move, which is the best case of a stepped simulation
+    p_Runner.Measure("lookup/update-grid-seeded", p_Parameters, particles,
+                     [&lookup, radius]() { lookup.UpdateGridLookup(radius, true); });
+
+    lookup.UpdateGridLookup(radius, true);
+
+    // The SoA copy is paid on every grid build, so its share of the build and of the pair pass below is what tells
+    // whether gathering beats streaming the interleaved positions directly
+    SoAArray<D> soa{};
+    p_Runner.Measure("lookup/soa-gather", p_Parameters, particles, [&soa, &p_State, &lookup]() {
+        soa.Gather(p_State.Positions, &lookup.Grid.ParticleIndices, true);
+        DoNotOptimize(soa.GetStream(0));
+    });
+
+    // The pair callback has no end of chunk to flush a local count at, so each thread counts on its own cache line to
+    // keep the measurement free of false sharing
+    struct alignas(64) PairCount
+    {
+        u64 Count = 0;
+    };
+    TKit::Array<PairCount, TKIT_THREAD_POOL_MAX_THREADS> pairs{};
+    p_Runner.Measure("lookup/for-each-pair-grid-mt", p_Parameters, particles, [&lookup, &pairs]() {
+        lookup.ForEachPairGridMT(
+            [&pairs](const u32, const u32, const f32, const u32 p_ThreadIndex) { ++pairs[p_ThreadIndex].Count; });
+        DoNotOptimize(pairs);
+    });
+    p_Runner.Measure("lookup/for-each-particle-grid", p_Parameters, particles, [&lookup, &pairs, particles]() {
+        Core::ForEach(0, particles, [&lookup, &pairs](const u32 p_Start, const u32 p_End, const u32 p_ThreadIndex) {
+            u64 count = 0;
+            for (u32 i = p_Start; i < p_End; ++i)
+                lookup.ForEachParticleGrid(i, [&count](const u32, const f32) { ++count; });
+            pairs[p_ThreadIndex].Count += count;
+        });
+        DoNotOptimize(pairs);
+    });
+    Core::EndParallelRegion();
+}
+
+// Full steps, after a couple of warm up steps so that the grid order and the caches settle
+template <Dimension D>
+static void runStepBenchmark(BenchmarkRunner &p_Runner, const BenchmarkParameters &p_Parameters,
+                             const SimulationState<D> &p_State, const SimulationSettings &p_Settings) noexcept
+{
+    if (!p_Runner.IsEnabled("step"))
+        return;
+
+    Solver<D> solver{p_Settings, p_State};
+    Core::BeginParallelRegion();
+    for (u32 i = 0; i < 2; ++i)
+        solver.Step(1.f / 60.f);
+    p_Runner.Measure("step", p_Parameters, solver.GetParticleCount(), [&solver]() { solver.Step(1.f / 60.f); });
+    Core::EndParallelRegion();
+}
+
+template <Dimension D> static void runBenchmarks(BenchmarkRunner &p_Runner, const BenchmarkOptions &p_Options)
+{
+    runKernelBenchmarks<D>(p_Runner);
+
+    const SimulationSettings defaults{};
+    for (const u32 threads : p_Options.ThreadCounts)
+    {
+        SetThreadCount(threads);
+        for (const Layout layout : p_Options.Layouts)
+            for (const u32 particles : p_Options.ParticleCounts)
+            {
+                const SimulationState<D> state = CreateLayoutState<D>(layout, particles, defaults);
+                BenchmarkParameters parameters{};
+                parameters.Add("dim", D)
+                    .Add("particles", particles)
+                    .Add("threads", threads)
+                    .Add("layout", ToString(layout));
+
+                runLookupBenchmarks<D>(p_Runner, parameters, state, defaults);
+                runStepBenchmark<D>(p_Runner, parameters, state, defaults);
+            }
+
+        // Every lookup and iteration mode on a single, moderate configuration
+        const SimulationState<D> state = CreateLayoutState<D>(Layout::Block, p_Options.ModeParticles, defaults);
+        for (u32 lookup = 0; lookup < 8; ++lookup)
+            for (u32 iteration = 0; iteration < 2; ++iteration)
+            {
+                SimulationSettings settings{};
+                settings.LookupMode = static_cast<ParticleLookupMode>(lookup);
+                settings.IterationMode = static_cast<ParticleIterationMode>(iteration);
+                if (threads > 1 && !settings.UsesMultiThread())
+                    continue;
+
+                BenchmarkParameters parameters{};
+                parameters.Add("dim", D)
+                    .Add("particles", p_Options.ModeParticles)
+                    .Add("threads", threads)
+                    .Add("layout", ToString(Layout::Block))
+                    .Add("lookup", s_LookupNames[lookup])
+                    .Add("iteration", s_IterationNames[iteration]);
+                runStepBenchmark<D>(p_Runner, parameters, state, settings);
+            }
+    }
+}
+
+static TKit::DynamicArray<std::string> split(const std::string &p_List) noexcept
+{
+    TKit::DynamicArray<std::string> values;
+    std::size_t start = 0;
+    while (start < p_List.size())
+    {
+        std::size_t end = p_List.find(',', start);
+        if (end == std::string::npos)
+            end = p_List.size();
+        if (end > start)
+            values.push_back(p_List.substr(start, end - start));
+        start = end + 1;
+    }
+    return values;
+}
+
+static TKit::DynamicArray<u32> parseList(const std::string &p_List) noexcept
+{
+    TKit::DynamicArray<u32> values;
+    for (const std::string &value : split(p_List))
+        values.push_back(static_cast<u32>(std::strtoul(value.c_str(), nullptr, 10)));
+    return values;
+}
+
+// Powers of two up to every available core, the latter included
+static TKit::DynamicArray<u32> getScalingThreadCounts() noexcept
+{
+    const u32 maxThreads = glm::min(Core::GetCpuTopology().LogicalCores, Core::GetMaxWorkerThreadCount() + 1);
+    TKit::DynamicArray<u32> threads;
+    for (u32 count = 1; count < maxThreads; count *= 2)
+        threads.push_back(count);
+    threads.push_back(maxThreads);
+    return threads;
+}
+
+static bool runScalingStudy(const argparse::ArgumentParser &p_Parser, const std::string &p_Mode,
+                            const BenchmarkOptions &p_Options) noexcept
+{
+    ScalingOptions options{};
+    options.Mode = p_Mode == "weak" ? ScalingMode::Weak : ScalingMode::Strong;
+    options.Steps = p_Parser.get<u32>("--steps");
+    // Phase times are averaged over the timed steps
+    if (options.Steps == 0)
+    {
+        std::cerr << "A scaling study needs at least one timed step" << std::endl;
+        return false;
+    }
+    options.StateLayout = p_Options.Layouts.empty() ? Layout::Block : p_Options.Layouts.front();
+    if (const auto particles = p_Parser.present("--particles"))
+        options.ParticleCounts = parseList(*particles);
+    else
+        options.ParticleCounts.push_back(options.Mode == ScalingMode::Strong ? 100000 : 20000);
+    options.ThreadCounts = p_Parser.present("--threads") ? p_Options.ThreadCounts : getScalingThreadCounts();
+
+    TKit::DynamicArray<ScalingRun> runs;
+    for (const u32 dimension : p_Options.Dimensions)
+    {
+        if (dimension == 2)
+            RunScalingStudy<D2>(options, runs);
+        else if (dimension == 3)
+            RunScalingStudy<D3>(options, runs);
+    }
+
+    WriteScalingTables(std::cout, options, runs);
+    if (const auto path = p_Parser.present("--output"))
+    {
+        std::ofstream file{*path};
+        WriteScalingJson(file, options, runs);
+    }
+    return true;
+}
+} // namespace Driz
+
+int main(int argc, char **argv)
+{
+    using namespace Driz;
+    argparse::ArgumentParser parser{"drizzle-bench", "1.0", argparse::default_arguments::all};
+    parser.add_description(
+        "Measures the kernels, the grid lookup passes and full simulation steps on synthetic particle layouts, and "
+        "writes the results as JSON so that they can be compared between builds.");
+    parser.add_argument("-o", "--output")
+        .help("Path of the JSON report. Written to stdout if not specified, unless running a scaling study.");
+    parser.add_argument("--filter").default_value(std::string{}).help(
+        "Only run the benchmarks whose name contains this string, such as 'kernel', 'lookup' or 'step'.");
+    parser.add_argument("--min-time")
+        .scan<'f', f32>()
+        .default_value(0.25f)
+        .help("Minimum time in seconds spent measuring each benchmark.");
+    parser.add_argument("--dims").default_value(std::string{"2,3"}).help("Comma separated dimensions.");
+    parser.add_argument("--particles")
+        .help("Comma separated particle counts. Defaults to 1000,10000,100000,1000000, or to 100000 for a strong "
+              "scaling study and 20000 per thread for a weak one.");
+    parser.add_argument("--threads").help(
+        "Comma separated thread counts, the main thread included. Defaults to 1 and one per performance core.");
+    parser.add_argument("--layouts")
+        .default_value(std::string{"block,dam-break,splash"})
+        .help("Comma separated layouts: a uniform 'block', a 'dam-break' in a wide box or a sparse 'splash'.");
+    parser.add_argument("--mode-particles")
+        .scan<'u', u32>()
+        .default_value(10000u)
+        .help("Particle count of the sweep over every lookup and iteration mode.");
+    parser.add_argument("--scaling")
+        .choices("strong", "weak")
+        .help("Runs a 'strong' or 'weak' scaling study of the default solver instead of the benchmarks. Thread counts "
+              "default to powers of two up to every core, and the particle counts of a weak study are per thread. "
+              "Prints the time, speedup and parallel efficiency of each step phase.");
+    parser.add_argument("--steps")
+        .scan<'u', u32>()
+        .default_value(50u)
+        .help("Steps timed for each run of a scaling study. Must be at least 1.");
+
+    try
+    {
+        parser.parse_args(argc, argv);
+    }
+    catch (const std::exception &err)
+    {
+        std::cerr << err.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Core::Initialize();
+    BenchmarkOptions options{};
+    options.Dimensions = parseList(parser.get("--dims"));
+    options.ParticleCounts = parseList(parser.present("--particles").value_or("1000,10000,100000,1000000"));
+    for (const std::string &name : split(parser.get("--layouts")))
+    {
+        if (const std::optional<Layout> layout = ParseLayout(name))
+            options.Layouts.push_back(*layout);
+        else
+            std::cerr << "Unknown layout '" << name << "', skipping it" << std::endl;
+    }
+    options.ModeParticles = parser.get<u32>("--mode-particles");
+    if (const auto threads = parser.present("--threads"))
+    {
+        for (const u32 count : parseList(*threads))
+            if (count > 0)
+                options.ThreadCounts.push_back(count);
+            else
+                std::cerr << "Thread counts must be at least 1, skipping 0" << std::endl;
+    }
+    else
+    {
+        options.ThreadCounts.push_back(1);
+        const u32 workers = Core::GetCpuTopology().GetDefaultWorkerCount();
+        if (workers > 0)
+            options.ThreadCounts.push_back(workers + 1);
+    }
+
+    if (const auto mode = parser.present("--scaling"))
+    {
+        const bool succeeded = runScalingStudy(parser, *mode, options);
+        Core::Terminate();
+        return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    BenchmarkRunner runner{parser.get<f32>("--min-time"), parser.get("--filter")};
+    for (const u32 dimension : options.Dimensions)
+    {
+        if (dimension == 2)
+            runBenchmarks<D2>(runner, options);
+        else if (dimension == 3)
+            runBenchmarks<D3>(runner, options);
+    }
+
+    if (const auto path = parser.present("--output"))
+    {
+        std::ofstream file{*path};
+        runner.WriteJson(file);
+    }
+    else
+        runner.WriteJson(std::cout);
+    Core::Terminate();
+}
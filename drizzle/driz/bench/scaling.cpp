@@ -0,0 +1,160 @@
+#include "driz/bench/scaling.hpp"
+#include "driz/core/report.hpp"
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace Driz
+{
+template <Dimension D>
+void RunScalingStudy(const ScalingOptions &p_Options, TKit::DynamicArray<ScalingRun> &p_Runs) noexcept
+{
+    for (u32 series = 0; series < p_Options.ParticleCounts.size(); ++series)
+        for (const u32 threads : p_Options.ThreadCounts)
+        {
+            const u32 count = p_Options.ParticleCounts[series];
+            const u32 particles = p_Options.Mode == ScalingMode::Strong ? count : count * threads;
+
+            SetThreadCount(threads);
+            const SimulationState<D> state = CreateLayoutState<D>(p_Options.StateLayout, particles, p_Options.Settings);
+            Solver<D> solver{p_Options.Settings, state};
+
+            // Warm up steps let the grid order and the scratch memory settle before anything is timed
+            StepTimings timings{};
+            Core::BeginParallelRegion();
+            for (u32 i = 0; i < p_Options.WarmupSteps + p_Options.Steps; ++i)
+            {
+                solver.Step(1.f / 60.f);
+                if (i < p_Options.WarmupSteps)
+                    continue;
+                for (u32 j = 0; j < StepPhaseCount; ++j)
+                    timings.Phases[j] += solver.GetStepTimings().Phases[j];
+            }
+            Core::EndParallelRegion();
+
+            ScalingRun run;
+            run.Dim = D;
+            run.Series = series;
+            run.Threads = threads;
+            run.Particles = particles;
+            run.TotalMs = 0.0;
+            for (u32 j = 0; j < StepPhaseCount; ++j)
+            {
+                run.PhaseMs[j] = static_cast<f64>(timings.Phases[j].AsMilliseconds()) / p_Options.Steps;
+                run.TotalMs += run.PhaseMs[j];
+            }
+            std::cerr << "Scaling " << static_cast<u32>(D) << "D, " << particles << " particles, " << threads
+                      << " threads: " << run.TotalMs << " ms per step" << std::endl;
+            p_Runs.push_back(run);
+        }
+}
+
+// Columns are the phases followed by the whole step
+static f64 getColumn(const ScalingRun &p_Run, const u32 p_Column) noexcept
+{
+    return p_Column < StepPhaseCount ? p_Run.PhaseMs[p_Column] : p_Run.TotalMs;
+}
+static const char *getColumnName(const u32 p_Column) noexcept
+{
+    return p_Column < StepPhaseCount ? ToString(static_cast<StepPhase>(p_Column)) : "Step";
+}
+
+static f64 getSpeedup(const ScalingMode p_Mode, const ScalingRun &p_Base, const ScalingRun &p_Run,
+                      const u32 p_Column) noexcept
+{
+    // Phases that take no measurable time, such as an EndStep without sinks or emitters, have no meaningful speedup
+    const f64 time = getColumn(p_Run, p_Column);
+    const f64 ratio = time > 0.0 ? getColumn(p_Base, p_Column) / time : 0.0;
+    return p_Mode == ScalingMode::Strong ? ratio : ratio * p_Run.Threads / p_Base.Threads;
+}
+static f64 getEfficiency(const ScalingMode p_Mode, const ScalingRun &p_Base, const ScalingRun &p_Run,
+                         const u32 p_Column) noexcept
+{
+    return getSpeedup(p_Mode, p_Base, p_Run, p_Column) * p_Base.Threads / p_Run.Threads;
+}
+
+template <typename F>
+static void writeTable(std::ostream &p_Stream, const char *p_Title, const ScalingRun *p_Runs, const u32 p_Count,
+                       F &&p_Value) noexcept
+{
+    p_Stream << p_Title << '\n' << std::setw(8) << "Threads" << std::setw(11) << "Particles";
+    for (u32 column = 0; column <= StepPhaseCount; ++column)
+        p_Stream << std::setw(static_cast<i32>(std::strlen(getColumnName(column)) + 2)) << getColumnName(column);
+    p_Stream << '\n';
+
+    for (u32 i = 0; i < p_Count; ++i)
+    {
+        p_Stream << std::setw(8) << p_Runs[i].Threads << std::setw(11) << p_Runs[i].Particles;
+        for (u32 column = 0; column <= StepPhaseCount; ++column)
+            p_Stream << std::setw(static_cast<i32>(std::strlen(getColumnName(column)) + 2))
+                     << p_Value(p_Runs[i], column);
+        p_Stream << '\n';
+    }
+    p_Stream << '\n';
+}
+
+void WriteScalingTables(std::ostream &p_Stream, const ScalingOptions &p_Options,
+                        const TKit::DynamicArray<ScalingRun> &p_Runs) noexcept
+{
+    const ScalingMode mode = p_Options.Mode;
+    const std::ios::fmtflags flags = p_Stream.flags();
+    p_Stream << std::fixed << std::setprecision(3);
+
+    u32 start = 0;
+    while (start < p_Runs.size())
+    {
+        const ScalingRun &base = p_Runs[start];
+        u32 end = start + 1;
+        while (end < p_Runs.size() && p_Runs[end].Dim == base.Dim && p_Runs[end].Series == base.Series)
+            ++end;
+        const ScalingRun *runs = p_Runs.data() + start;
+        const u32 count = end - start;
+
+        p_Stream << (mode == ScalingMode::Strong ? "Strong" : "Weak") << " scaling, " << static_cast<u32>(base.Dim)
+                 << "D, " << ToString(p_Options.StateLayout) << ", " << p_Options.ParticleCounts[base.Series]
+                 << (mode == ScalingMode::Strong ? " particles" : " particles per thread") << "\n\n";
+        writeTable(p_Stream, "Time per step (ms)", runs, count,
+                   [](const ScalingRun &p_Run, const u32 p_Column) { return getColumn(p_Run, p_Column); });
+        writeTable(p_Stream, "Speedup", runs, count, [mode, &base](const ScalingRun &p_Run, const u32 p_Column) {
+            return getSpeedup(mode, base, p_Run, p_Column);
+        });
+        writeTable(p_Stream, "Parallel efficiency", runs, count,
+                   [mode, &base](const ScalingRun &p_Run, const u32 p_Column) {
+                       return getEfficiency(mode, base, p_Run, p_Column);
+                   });
+        start = end;
+    }
+    p_Stream.flags(flags);
+}
+
+void WriteScalingJson(std::ostream &p_Stream, const ScalingOptions &p_Options,
+                      const TKit::DynamicArray<ScalingRun> &p_Runs) noexcept
+{
+    p_Stream << "{\n  ";
+    WriteReportContext(p_Stream);
+    p_Stream << ",\n  \"mode\": \""
+             << (p_Options.Mode == ScalingMode::Strong ? "strong" : "weak") << "\", \"layout\": \""
+             << ToString(p_Options.StateLayout) << "\", \"steps\": " << p_Options.Steps << ",\n  \"runs\": [";
+
+    const ScalingRun *base = nullptr;
+    for (u32 i = 0; i < p_Runs.size(); ++i)
+    {
+        const ScalingRun &run = p_Runs[i];
+        if (!base || base->Dim != run.Dim || base->Series != run.Series)
+            base = &run;
+
+        p_Stream << (i == 0 ? "\n" : ",\n") << "    {\"dim\": " << static_cast<u32>(run.Dim)
+                 << ", \"threads\": " << run.Threads << ", \"particles\": " << run.Particles << ", \"phases\": {";
+        for (u32 column = 0; column <= StepPhaseCount; ++column)
+            p_Stream << (column == 0 ? "" : ", ") << '"' << getColumnName(column)
+                     << "\": {\"ms\": " << getColumn(run, column)
+                     << ", \"speedup\": " << getSpeedup(p_Options.Mode, *base, run, column)
+                     << ", \"efficiency\": " << getEfficiency(p_Options.Mode, *base, run, column) << "}";
+        p_Stream << "}}";
+    }
+    p_Stream << "\n  ]\n}" << std::endl;
+}
+
+template void RunScalingStudy<D2>(const ScalingOptions &, TKit::DynamicArray<ScalingRun> &) noexcept;
+template void RunScalingStudy<D3>(const ScalingOptions &, TKit::DynamicArray<ScalingRun> &) noexcept;
+} // namespace Driz
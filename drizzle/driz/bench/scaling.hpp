@@ -0,0 +1,51 @@
+#pragma once
+
+#include "driz/bench/layout.hpp"
+#include "driz/simulation/solver.hpp"
+#include <iosfwd>
+
+namespace Driz
+{
+// Strong scaling keeps the particle count fixed as threads are added, weak scaling keeps the particles per thread
+enum class ScalingMode : u8
+{
+    Strong = 0,
+    Weak
+};
+
+struct ScalingOptions
+{
+    TKit::DynamicArray<u32> ThreadCounts;
+    // Total particles with strong scaling, particles per thread with weak scaling
+    TKit::DynamicArray<u32> ParticleCounts;
+    SimulationSettings Settings{};
+    Layout StateLayout = Layout::Block;
+    ScalingMode Mode = ScalingMode::Strong;
+    u32 WarmupSteps = 5;
+    u32 Steps = 50;
+};
+
+struct ScalingRun
+{
+    Dimension Dim;
+    // Index of the particle count the run belongs to
+    u32 Series;
+    u32 Threads;
+    u32 Particles;
+    // Mean time per step of each phase, in milliseconds
+    TKit::Array<f64, StepPhaseCount> PhaseMs;
+    f64 TotalMs;
+};
+
+// Runs every particle count with every thread count and appends the results. Runs of the same series are consecutive
+template <Dimension D>
+void RunScalingStudy(const ScalingOptions &p_Options, TKit::DynamicArray<ScalingRun> &p_Runs) noexcept;
+
+// Times, speedups and parallel efficiencies of each phase, relative to the first thread count of each series. With
+// strong scaling, the speedup is T0 / T and the efficiency the speedup over the relative thread count. With weak
+// scaling, the efficiency is T0 / T and the speedup the efficiency times the relative thread count
+void WriteScalingTables(std::ostream &p_Stream, const ScalingOptions &p_Options,
+                        const TKit::DynamicArray<ScalingRun> &p_Runs) noexcept;
+void WriteScalingJson(std::ostream &p_Stream, const ScalingOptions &p_Options,
+                      const TKit::DynamicArray<ScalingRun> &p_Runs) noexcept;
+} // namespace Driz
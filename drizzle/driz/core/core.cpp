@@ -1,5 +1,4 @@
 #include "driz/core/core.hpp"
-#include "onyx/core/core.hpp"
 #include "tkit/utils/literals.hpp"
 
 namespace Driz
@@ -7,16 +6,57 @@ namespace Driz
 using namespace TKit::Literals;
 
 static TKit::Storage<TKit::ThreadPool> s_ThreadPool;
-static TKit::ArenaAllocator s_Arena{1_mb};
+static bool s_HasThreadPool = false;
+static u32 s_ThreadCount = 0;
+static TKit::Storage<WorkerTeam> s_WorkerTeam;
+static bool s_UseWorkerTeam = true;
+static CpuTopology s_Topology;
+static bool s_PinThreads = true;
+static bool s_FirstTouch = false;
+static TKit::Storage<TKit::ArenaAllocator> s_Arena;
+static u64 s_ArenaSize = 4_mb;
+static TKit::Array<TKit::Timespan, TKIT_THREAD_POOL_MAX_THREADS> s_BusyTimes{};
 
 static fs::path s_SettingsPath = fs::path(DRIZ_ROOT_PATH) / "saves" / "settings";
 static fs::path s_StatePath2 = fs::path(DRIZ_ROOT_PATH) / "saves" / "2D";
 static fs::path s_StatePath3 = fs::path(DRIZ_ROOT_PATH) / "saves" / "3D";
 
-void Core::Initialize() noexcept
+// The pool is only built once something asks for it, such as the app handing it to Onyx or the worker team being
+// disabled, so that runs on the team do not keep a second, idle set of threads around
+static void createThreadPool() noexcept
 {
-    s_ThreadPool.Construct(7);
-    Onyx::Core::Initialize(s_ThreadPool.Get());
+    s_ThreadPool.Construct(s_ThreadCount);
+    s_HasThreadPool = true;
+}
+static void destroyThreadPool() noexcept
+{
+    if (!s_HasThreadPool)
+        return;
+    s_ThreadPool.Destruct();
+    s_HasThreadPool = false;
+}
+
+static void createThreads(const u32 p_ThreadCount) noexcept
+{
+    const bool hadThreadPool = s_HasThreadPool;
+    destroyThreadPool();
+    s_ThreadCount = std::min(p_ThreadCount, Core::GetMaxWorkerThreadCount());
+    // Whoever held the previous pool keeps a pointer to the same storage, so it is rebuilt in place
+    if (hadThreadPool || !s_UseWorkerTeam)
+        createThreadPool();
+    s_WorkerTeam.Construct(s_ThreadCount, s_PinThreads ? &s_Topology : nullptr);
+}
+
+void Core::Initialize(const ThreadingSpecs &p_Specs) noexcept
+{
+    s_Arena.Construct(s_ArenaSize);
+    s_Topology = DetectCpuTopology();
+    s_PinThreads = p_Specs.PinThreads;
+    s_FirstTouch = p_Specs.FirstTouch;
+    if (s_PinThreads)
+        PinCurrentThread(s_Topology.GetPlacement(0));
+
+    createThreads(p_Specs.WorkerCount == UINT32_MAX ? s_Topology.GetDefaultWorkerCount() : p_Specs.WorkerCount);
 
     fs::create_directories(s_SettingsPath);
     fs::create_directories(s_StatePath2);
@@ -24,22 +64,94 @@ void Core::Initialize() noexcept
 }
 void Core::Terminate() noexcept
 {
-    Onyx::Core::Terminate();
-    s_ThreadPool.Destruct();
+    s_WorkerTeam.Destruct();
+    destroyThreadPool();
+    s_Arena.Destruct();
 }
 
 TKit::ArenaAllocator &Core::GetArena() noexcept
 {
-    return s_Arena;
+    return *s_Arena.Get();
+}
+void Core::ReserveArena(const u64 p_Size) noexcept
+{
+    if (p_Size <= s_ArenaSize)
+        return;
+    s_ArenaSize = std::max(p_Size, 2 * s_ArenaSize);
+    s_Arena.Destruct();
+    s_Arena.Construct(s_ArenaSize);
 }
 TKit::ThreadPool &Core::GetThreadPool() noexcept
 {
+    if (!s_HasThreadPool)
+        createThreadPool();
     return *s_ThreadPool.Get();
 }
 void Core::SetWorkerThreadCount(const u32 p_ThreadCount) noexcept
 {
-    s_ThreadPool.Destruct();
-    s_ThreadPool.Construct(p_ThreadCount);
+    s_WorkerTeam.Destruct();
+    createThreads(p_ThreadCount);
+}
+u32 Core::GetWorkerThreadCount() noexcept
+{
+    return s_ThreadCount;
+}
+u32 Core::GetMaxWorkerThreadCount() noexcept
+{
+    return TKIT_THREAD_POOL_MAX_THREADS - 1;
+}
+
+const CpuTopology &Core::GetCpuTopology() noexcept
+{
+    return s_Topology;
+}
+bool Core::IsFirstTouchEnabled() noexcept
+{
+    return s_FirstTouch;
+}
+
+void Core::SetWorkerTeamEnabled(const bool p_Enabled) noexcept
+{
+    if (!p_Enabled && !s_HasThreadPool)
+        createThreadPool();
+    s_UseWorkerTeam = p_Enabled;
+}
+bool Core::IsWorkerTeamEnabled() noexcept
+{
+    return s_UseWorkerTeam;
+}
+WorkerTeam &Core::GetWorkerTeam() noexcept
+{
+    return *s_WorkerTeam.Get();
+}
+
+u32 Core::GetThreadCount() noexcept
+{
+    return s_ThreadCount + 1;
+}
+
+void Core::BeginParallelRegion() noexcept
+{
+    if (s_UseWorkerTeam)
+        s_WorkerTeam.Get()->SetSpinning(true);
+}
+void Core::EndParallelRegion() noexcept
+{
+    s_WorkerTeam.Get()->SetSpinning(false);
+}
+
+// Threads only ever touch their own entry, so no synchronization is needed
+void Core::ResetBusyTimes() noexcept
+{
+    s_BusyTimes.fill(TKit::Timespan{});
+}
+void Core::AddBusyTime(const u32 p_ThreadIndex, const TKit::Timespan p_Time) noexcept
+{
+    s_BusyTimes[p_ThreadIndex] += p_Time;
+}
+TKit::Timespan Core::GetBusyTime(const u32 p_ThreadIndex) noexcept
+{
+    return s_BusyTimes[p_ThreadIndex];
 }
 
 const fs::path &Core::GetSettingsPath() noexcept
@@ -2,40 +2,166 @@
 
 #include "driz/core/alias.hpp"
 #include "driz/core/dimension.hpp"
+#include "driz/core/sim_array.hpp"
+#include "driz/core/worker_team.hpp"
+#include "driz/core/topology.hpp"
 #include "tkit/memory/arena_allocator.hpp"
 #include "tkit/container/static_array.hpp"
 #include "tkit/multiprocessing/thread_pool.hpp"
 #include "tkit/multiprocessing/for_each.hpp"
+#include "tkit/profiling/clock.hpp"
 #include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 
 // #define DRIZ_ENABLE_INSPECTOR
 
+// Compiles a function once per instruction set and picks the best one for the running CPU at load time
+#if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__)
+#    define DRIZ_SIMD_CLONES __attribute__((target_clones("avx512f", "avx2", "sse4.2", "default")))
+#else
+#    define DRIZ_SIMD_CLONES
+#endif
+
 namespace Driz
 {
 namespace fs = std::filesystem;
 
-template <typename T> using SimArray = TKit::StaticArray<T, 70000>;
+struct ThreadingSpecs
+{
+    // Threads besides the main one. By default, one per performance core
+    u32 WorkerCount = UINT32_MAX;
+    // Pins each thread to its own physical core, fastest cores first
+    bool PinThreads = true;
+    // Lets every worker be the first to write its share of the particle buffers, so that the memory ends up in the
+    // NUMA node of the core that works on it. Only pays off with pinned threads on multi-socket machines
+    bool FirstTouch = false;
+};
 
 struct Core
 {
-    static void Initialize() noexcept;
+    static void Initialize(const ThreadingSpecs &p_Specs = {}) noexcept;
     static void Terminate() noexcept;
 
     static TKit::ArenaAllocator &GetArena() noexcept;
+    // Grows the scratch arena, which must be empty, so that it holds at least p_Size bytes. Scratch needs scale with
+    // the particle count, so callers reserve before allocating
+    static void ReserveArena(u64 p_Size) noexcept;
+    // Built on first use, see SetWorkerTeamEnabled
     static TKit::ThreadPool &GetThreadPool() noexcept;
     static void SetWorkerThreadCount(u32 p_ThreadCount) noexcept;
+    // Threads besides the main one, shared by the worker team and the pool
+    static u32 GetWorkerThreadCount() noexcept;
+    static u32 GetMaxWorkerThreadCount() noexcept;
+
+    static const CpuTopology &GetCpuTopology() noexcept;
+    static bool IsFirstTouchEnabled() noexcept;
 
     static const fs::path &GetSettingsPath() noexcept;
 
     template <Dimension D> static const fs::path &GetStatePath() noexcept;
 
+    // Time each thread spent working inside ForEach calls since the last reset, which makes load imbalance visible
+    static void ResetBusyTimes() noexcept;
+    static void AddBusyTime(u32 p_ThreadIndex, TKit::Timespan p_Time) noexcept;
+    static TKit::Timespan GetBusyTime(u32 p_ThreadIndex) noexcept;
+
+    // ForEach calls run on a persistent team of workers rather than as thread pool tasks. The pool is still used
+    // when the team is disabled, and is only built then unless something else asked for it before
+    static void SetWorkerTeamEnabled(bool p_Enabled) noexcept;
+    static bool IsWorkerTeamEnabled() noexcept;
+    static WorkerTeam &GetWorkerTeam() noexcept;
+
+    // Number of threads taking part in a ForEach call, the calling one included. Thread indices passed to ForEach
+    // functions are always below this value
+    static u32 GetThreadCount() noexcept;
+
+    // Keeps the team spinning between ForEach calls, so that a sequence of short parallel phases, such as a whole
+    // step, behaves as a single parallel region with a barrier between phases
+    static void BeginParallelRegion() noexcept;
+    static void EndParallelRegion() noexcept;
+
     template <typename F> static void ForEach(const u32 p_Start, const u32 p_End, F &&p_Function) noexcept
     {
+        const u32 partitions = GetThreadCount();
+        runPartitions([p_Start, p_End, partitions, &p_Function](const u32 p_Partition, const u32 p_ThreadIndex) {
+            const u64 size = p_End - p_Start;
+            const u32 start = p_Start + static_cast<u32>(size * p_Partition / partitions);
+            const u32 end = p_Start + static_cast<u32>(size * (p_Partition + 1) / partitions);
+
+            const TKit::Clock clock{};
+            p_Function(start, end, p_ThreadIndex);
+            AddBusyTime(p_ThreadIndex, clock.GetElapsed());
+        });
+    }
+
+    // Like ForEach, but the range is cut into several chunks per thread of roughly equal cost, which threads claim as
+    // they become idle. A few expensive items can then no longer stall a whole pass on a single thread.
+    // p_CostPrefix[i] must hold the total cost of all items before i, for every i in [p_Start, p_End]
+    template <typename T, typename F>
+    static void ForEachWeighted(const u32 p_Start, const u32 p_End, const T *p_CostPrefix, F &&p_Function) noexcept
+    {
+        if (p_Start >= p_End)
+            return;
+        const u32 chunks = GetThreadCount() * s_ChunksPerThread;
+
+        const u64 base = p_CostPrefix[p_Start];
+        const u64 cost = p_CostPrefix[p_End] - base;
+        const auto chunkStart = [=](const u32 p_Chunk) {
+            if (p_Chunk == chunks)
+                return p_End;
+            const T target = static_cast<T>(base + cost * p_Chunk / chunks);
+            return static_cast<u32>(std::lower_bound(p_CostPrefix + p_Start, p_CostPrefix + p_End, target) -
+                                    p_CostPrefix);
+        };
+
+        std::atomic<u32> next{0};
+        runPartitions([&next, &chunkStart, &p_Function, chunks](const u32, const u32 p_ThreadIndex) {
+            const TKit::Clock clock{};
+            for (u32 chunk = next.fetch_add(1, std::memory_order_relaxed); chunk < chunks;
+                 chunk = next.fetch_add(1, std::memory_order_relaxed))
+            {
+                const u32 start = chunkStart(chunk);
+                const u32 end = chunkStart(chunk + 1);
+                if (start < end)
+                    p_Function(start, end, p_ThreadIndex);
+            }
+            AddBusyTime(p_ThreadIndex, clock.GetElapsed());
+        });
+    }
+
+    // Reserves room for p_Count elements and zeroes it with the same partitioning ForEach uses, so that each page
+    // is first touched by the thread that will later work on it. Only fresh allocations are affected, as pages stay
+    // wherever they were first touched
+    template <typename T> static void FirstTouch(SimArray<T> &p_Array, const u32 p_Count) noexcept
+    {
+        p_Array.reserve(p_Count);
+        T *data = p_Array.data();
+        ForEach(0, p_Count, [data](const u32 p_Start, const u32 p_End, const u32) {
+            std::memset(static_cast<void *>(data + p_Start), 0, (p_End - p_Start) * sizeof(T));
+        });
+    }
+
+  private:
+    static constexpr u32 s_ChunksPerThread = 8;
+
+    // Calls p_Function(partition, threadIndex) once per partition, one partition per thread plus the calling one
+    template <typename F> static void runPartitions(F &&p_Function) noexcept
+    {
+        if (IsWorkerTeamEnabled())
+        {
+            GetWorkerTeam().Run([&p_Function](const u32 p_ThreadIndex) { p_Function(p_ThreadIndex, p_ThreadIndex); });
+            return;
+        }
+
         TKit::ThreadPool &pool = GetThreadPool();
         const u32 partitions = pool.GetThreadCount() + 1;
         TKit::Array<TKit::Ref<TKit::Task<void>>, TKIT_THREAD_POOL_MAX_THREADS> tasks;
-
-        TKit::ForEachMainThreadLead(pool, p_Start, p_End, tasks.begin(), partitions, std::forward<F>(p_Function));
+        TKit::ForEachMainThreadLead(pool, 0, partitions, tasks.begin(), partitions,
+                                    [&p_Function](const u32 p_Partition, const u32, const u32 p_ThreadIndex) {
+                                        p_Function(p_Partition, p_ThreadIndex);
+                                    });
         for (u32 i = 0; i < partitions - 1; ++i)
             tasks[i]->WaitUntilFinished();
     }
@@ -0,0 +1,40 @@
+#include "driz/core/report.hpp"
+#include "driz/core/core.hpp"
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+
+namespace Driz
+{
+SampleStatistics ComputeStatistics(TKit::DynamicArray<f64> &p_Samples) noexcept
+{
+    SampleStatistics stats{};
+    stats.Count = static_cast<u32>(p_Samples.size());
+    if (stats.Count == 0)
+        return stats;
+
+    for (const f64 sample : p_Samples)
+        stats.Mean += sample;
+    stats.Mean /= stats.Count;
+
+    f64 variance = 0.0;
+    for (const f64 sample : p_Samples)
+        variance += (sample - stats.Mean) * (sample - stats.Mean);
+    stats.StdDev = std::sqrt(variance / stats.Count);
+
+    std::sort(p_Samples.begin(), p_Samples.end());
+    const u32 half = stats.Count / 2;
+    stats.Median = stats.Count % 2 == 1 ? p_Samples[half] : 0.5 * (p_Samples[half - 1] + p_Samples[half]);
+    stats.Min = p_Samples.front();
+    return stats;
+}
+
+void WriteReportContext(std::ostream &p_Stream) noexcept
+{
+    const CpuTopology &topology = Core::GetCpuTopology();
+    p_Stream << "\"context\": {\"logical_cores\": " << topology.LogicalCores
+             << ", \"physical_cores\": " << topology.PhysicalCores
+             << ", \"performance_cores\": " << topology.PerformanceCores
+             << ", \"numa_nodes\": " << topology.NumaNodes << "}";
+}
+} // namespace Driz
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "driz/core/alias.hpp"
+#include <iosfwd>
+
+namespace Driz
+{
+// Summary of a set of timing samples. Everything is zero if there are no samples
+struct SampleStatistics
+{
+    f64 Mean = 0.0;
+    f64 Median = 0.0;
+    f64 Min = 0.0;
+    f64 StdDev = 0.0;
+    u32 Count = 0;
+};
+
+// Sorts the samples in place to find the median
+SampleStatistics ComputeStatistics(TKit::DynamicArray<f64> &p_Samples) noexcept;
+
+// Writes the "context" member shared by every JSON report: the CPU topology the measurements were taken on
+void WriteReportContext(std::ostream &p_Stream) noexcept;
+} // namespace Driz
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "driz/core/sim_array.hpp"
+#include "tkit/serialization/yaml/container.hpp"
+
+namespace YAML
+{
+// Particle arrays are stored as plain YAML sequences
+template <typename T> struct convert<Driz::SimArray<T>>
+{
+    static Node encode(const Driz::SimArray<T> &p_Array) noexcept
+    {
+        Node node;
+        for (const T &value : p_Array)
+            node.push_back(value);
+        return node;
+    }
+
+    static bool decode(const Node &p_Node, Driz::SimArray<T> &p_Array) noexcept
+    {
+        if (!p_Node.IsSequence())
+            return false;
+
+        p_Array.clear();
+        p_Array.reserve(static_cast<Driz::u32>(p_Node.size()));
+        for (const Node &value : p_Node)
+            p_Array.push_back(value.as<T>());
+        return true;
+    }
+};
+} // namespace YAML
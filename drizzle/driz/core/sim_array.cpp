@@ -0,0 +1,14 @@
+#include "driz/core/sim_array.hpp"
+#ifdef __linux__
+#    include <sys/mman.h>
+#endif
+
+namespace Driz
+{
+void AdviseHugePages([[maybe_unused]] void *p_Data, [[maybe_unused]] const u64 p_Bytes) noexcept
+{
+#ifdef MADV_HUGEPAGE
+    madvise(p_Data, p_Bytes, MADV_HUGEPAGE);
+#endif
+}
+} // namespace Driz
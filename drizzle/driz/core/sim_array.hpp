@@ -0,0 +1,245 @@
+#pragma once
+
+#include "driz/core/alias.hpp"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Driz
+{
+// Asks the OS to back the given range with transparent huge pages, which cuts TLB misses when streaming through
+// millions of particles. Does nothing where that is not supported
+void AdviseHugePages(void *p_Data, u64 p_Bytes) noexcept;
+
+// Growable storage for per-particle data. Buffers are aligned to a cache line, or to a huge page once they are large
+// enough to span one, and grow geometrically so that appending is amortized constant time. Arrays are move-only, as
+// copying millions of particles should never happen by accident: a copy has to be requested with Clone()
+template <typename T> class SimArray
+{
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>,
+                  "Elements are relocated with memcpy and never destroyed");
+
+  public:
+    static constexpr u64 CacheLineSize = 64;
+    static constexpr u64 HugePageSize = 2 * 1024 * 1024;
+
+    using value_type = T;
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    SimArray() noexcept = default;
+    explicit SimArray(const u32 p_Size, const T &p_Value = T{}) noexcept
+    {
+        resize(p_Size, p_Value);
+    }
+    ~SimArray() noexcept
+    {
+        deallocate(m_Data, m_Alignment);
+    }
+
+    SimArray(SimArray &&p_Other) noexcept
+        : m_Data(std::exchange(p_Other.m_Data, nullptr)), m_Alignment(std::exchange(p_Other.m_Alignment, 0)),
+          m_Size(std::exchange(p_Other.m_Size, 0)), m_Capacity(std::exchange(p_Other.m_Capacity, 0))
+    {
+    }
+    SimArray &operator=(SimArray &&p_Other) noexcept
+    {
+        if (this != &p_Other)
+        {
+            deallocate(m_Data, m_Alignment);
+            m_Data = std::exchange(p_Other.m_Data, nullptr);
+            m_Alignment = std::exchange(p_Other.m_Alignment, 0);
+            m_Size = std::exchange(p_Other.m_Size, 0);
+            m_Capacity = std::exchange(p_Other.m_Capacity, 0);
+        }
+        return *this;
+    }
+
+    SimArray(const SimArray &) = delete;
+    SimArray &operator=(const SimArray &) = delete;
+
+    SimArray Clone() const noexcept
+    {
+        SimArray copy;
+        copy.assign(begin(), end());
+        return copy;
+    }
+
+    // New elements are left uninitialized
+    void reserve(const u32 p_Capacity) noexcept
+    {
+        if (p_Capacity > m_Capacity)
+            reallocate(p_Capacity);
+    }
+    void resize(const u32 p_Size) noexcept
+    {
+        resize(p_Size, T{});
+    }
+    void resize(const u32 p_Size, const T &p_Value) noexcept
+    {
+        if (p_Size > m_Capacity)
+        {
+            const T value = p_Value;
+            grow(p_Size);
+            std::fill(m_Data + m_Size, m_Data + p_Size, value);
+        }
+        else if (p_Size > m_Size)
+            std::fill(m_Data + m_Size, m_Data + p_Size, p_Value);
+        m_Size = p_Size;
+    }
+    // Like resize, but new elements are left uninitialized, for callers that fill them in parallel
+    void resize_uninitialized(const u32 p_Size) noexcept
+    {
+        if (p_Size > m_Capacity)
+            grow(p_Size);
+        m_Size = p_Size;
+    }
+    void assign(const u32 p_Size, const T &p_Value) noexcept
+    {
+        clear();
+        resize(p_Size, p_Value);
+    }
+    // The range must not overlap this array
+    void assign(const T *p_Begin, const T *p_End) noexcept
+    {
+        const u32 size = static_cast<u32>(p_End - p_Begin);
+        clear();
+        reserve(size);
+        if (size != 0)
+            std::memcpy(m_Data, p_Begin, size * sizeof(T));
+        m_Size = size;
+    }
+
+    void push_back(const T &p_Value) noexcept
+    {
+        if (m_Size == m_Capacity)
+        {
+            // The value may live in this very array
+            const T value = p_Value;
+            grow(m_Size + 1);
+            m_Data[m_Size++] = value;
+        }
+        else
+            m_Data[m_Size++] = p_Value;
+    }
+    template <typename... Args> T &emplace_back(Args &&...p_Args) noexcept
+    {
+        push_back(T{std::forward<Args>(p_Args)...});
+        return back();
+    }
+    void pop_back() noexcept
+    {
+        --m_Size;
+    }
+    void clear() noexcept
+    {
+        m_Size = 0;
+    }
+
+    T &operator[](const u32 p_Index) noexcept
+    {
+        return m_Data[p_Index];
+    }
+    const T &operator[](const u32 p_Index) const noexcept
+    {
+        return m_Data[p_Index];
+    }
+    T &front() noexcept
+    {
+        return m_Data[0];
+    }
+    const T &front() const noexcept
+    {
+        return m_Data[0];
+    }
+    T &back() noexcept
+    {
+        return m_Data[m_Size - 1];
+    }
+    const T &back() const noexcept
+    {
+        return m_Data[m_Size - 1];
+    }
+
+    T *data() noexcept
+    {
+        return m_Data;
+    }
+    const T *data() const noexcept
+    {
+        return m_Data;
+    }
+
+    T *begin() noexcept
+    {
+        return m_Data;
+    }
+    T *end() noexcept
+    {
+        return m_Data + m_Size;
+    }
+    const T *begin() const noexcept
+    {
+        return m_Data;
+    }
+    const T *end() const noexcept
+    {
+        return m_Data + m_Size;
+    }
+
+    u32 size() const noexcept
+    {
+        return m_Size;
+    }
+    u32 capacity() const noexcept
+    {
+        return m_Capacity;
+    }
+    bool empty() const noexcept
+    {
+        return m_Size == 0;
+    }
+
+  private:
+    static u64 getAlignment(const u32 p_Capacity) noexcept
+    {
+        return p_Capacity * sizeof(T) >= HugePageSize ? HugePageSize : CacheLineSize;
+    }
+    static void deallocate(T *p_Data, const u64 p_Alignment) noexcept
+    {
+        if (p_Data)
+            ::operator delete[](p_Data, std::align_val_t{p_Alignment});
+    }
+
+    void grow(const u32 p_Required) noexcept
+    {
+        reallocate(std::max({p_Required, m_Capacity * 2, static_cast<u32>(CacheLineSize)}));
+    }
+    void reallocate(u32 p_Capacity) noexcept
+    {
+        // The allocation is rounded up to its alignment and the slack is handed out as extra capacity. The rounded
+        // capacity may map to a different alignment than the requested one, so the one used is stored for deallocate()
+        const u64 alignment = getAlignment(p_Capacity);
+        const u64 bytes = (p_Capacity * sizeof(T) + alignment - 1) / alignment * alignment;
+        p_Capacity = static_cast<u32>(bytes / sizeof(T));
+
+        T *data = static_cast<T *>(::operator new[](bytes, std::align_val_t{alignment}));
+        if (alignment == HugePageSize)
+            AdviseHugePages(data, bytes);
+        if (m_Size != 0)
+            std::memcpy(data, m_Data, m_Size * sizeof(T));
+
+        deallocate(m_Data, m_Alignment);
+        m_Data = data;
+        m_Alignment = alignment;
+        m_Capacity = p_Capacity;
+    }
+
+    T *m_Data = nullptr;
+    u64 m_Alignment = 0;
+    u32 m_Size = 0;
+    u32 m_Capacity = 0;
+};
+} // namespace Driz
@@ -0,0 +1,46 @@
+#include "driz/core/soa_array.hpp"
+#include <algorithm>
+
+namespace Driz
+{
+static constexpr f32 s_PaddingValue = 1e30f;
+
+template <Dimension D> void SoAArray<D>::Resize(const u32 p_Size) noexcept
+{
+    const u32 padded = (p_Size + Lanes - 1) / Lanes * Lanes;
+    if (padded > m_Capacity)
+    {
+        f32 *data = static_cast<f32 *>(::operator new[](D * padded * sizeof(f32), std::align_val_t{Alignment}));
+        for (u32 i = 0; i < D && m_Data; ++i)
+            std::copy(GetStream(i), GetStream(i) + m_Size, data + i * padded);
+        m_Data.reset(data);
+        m_Capacity = padded;
+    }
+    m_Size = p_Size;
+    for (u32 i = 0; i < D; ++i)
+        std::fill(GetStream(i) + m_Size, GetStream(i) + GetPaddedSize(), s_PaddingValue);
+}
+
+template <Dimension D>
+void SoAArray<D>::Gather(const SimArray<fvec<D>> &p_Source, const SimArray<u32> *p_Order,
+                         const bool p_MultiThread) noexcept
+{
+    Resize(p_Source.size());
+    const auto gather = [this, &p_Source, p_Order](const u32 p_Start, const u32 p_End, const u32) {
+        for (u32 j = p_Start; j < p_End; ++j)
+            Set(j, p_Source[p_Order ? (*p_Order)[j] : j]);
+    };
+    if (p_MultiThread)
+        Core::ForEach(0, m_Size, gather);
+    else
+        gather(0, m_Size, 0);
+}
+
+template <Dimension D> u32 SoAArray<D>::GetPaddedSize() const noexcept
+{
+    return (m_Size + Lanes - 1) / Lanes * Lanes;
+}
+
+template class SoAArray<D2>;
+template class SoAArray<D3>;
+} // namespace Driz
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "driz/core/glm.hpp"
+#include "driz/core/core.hpp"
+#include <memory>
+
+namespace Driz
+{
+// Vector quantities stored as one contiguous float stream per axis, so that kernels can load full SIMD registers of
+// a single component instead of wasting lanes on interleaved x/y/z. Streams are aligned and padded to a whole
+// register, and the padding holds far away values so that full-width distance checks never accept it
+template <Dimension D> class SoAArray
+{
+  public:
+    static constexpr u32 Alignment = 64;
+    static constexpr u32 Lanes = Alignment / sizeof(f32);
+
+    void Resize(u32 p_Size) noexcept;
+
+    // Fills the streams from an array of vectors, optionally in the order given by p_Order
+    void Gather(const SimArray<fvec<D>> &p_Source, const SimArray<u32> *p_Order = nullptr,
+                bool p_MultiThread = false) noexcept;
+
+    fvec<D> Get(const u32 p_Index) const noexcept
+    {
+        fvec<D> value;
+        for (u32 i = 0; i < D; ++i)
+            value[i] = GetStream(i)[p_Index];
+        return value;
+    }
+    void Set(const u32 p_Index, const fvec<D> &p_Value) noexcept
+    {
+        for (u32 i = 0; i < D; ++i)
+            GetStream(i)[p_Index] = p_Value[i];
+    }
+
+    f32 *GetStream(const u32 p_Axis) noexcept
+    {
+        return m_Data.get() + p_Axis * m_Capacity;
+    }
+    const f32 *GetStream(const u32 p_Axis) const noexcept
+    {
+        return m_Data.get() + p_Axis * m_Capacity;
+    }
+
+    u32 size() const noexcept
+    {
+        return m_Size;
+    }
+    bool empty() const noexcept
+    {
+        return m_Size == 0;
+    }
+    u32 GetPaddedSize() const noexcept;
+
+  private:
+    struct Deleter
+    {
+        void operator()(f32 *p_Data) const noexcept
+        {
+            ::operator delete[](p_Data, std::align_val_t{Alignment});
+        }
+    };
+
+    std::unique_ptr<f32[], Deleter> m_Data;
+    u32 m_Size = 0;
+    u32 m_Capacity = 0;
+};
+} // namespace Driz
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "driz/core/alias.hpp"
+#include "tkit/container/array.hpp"
+#include <atomic>
+
+namespace Driz
+{
+// Fixed capacity ring buffer for exactly one producer thread and one consumer thread. Neither side ever blocks: a
+// push fails when the queue is full and a pop fails when it is empty
+template <typename T, u32 Capacity> class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "The capacity must be a power of two");
+
+  public:
+    bool Push(const T &p_Value) noexcept
+    {
+        const u32 tail = m_Tail.load(std::memory_order_relaxed);
+        if (tail - m_Head.load(std::memory_order_acquire) == Capacity)
+            return false;
+        m_Elements[tail & (Capacity - 1)] = p_Value;
+        m_Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T &p_Value) noexcept
+    {
+        const u32 head = m_Head.load(std::memory_order_relaxed);
+        if (head == m_Tail.load(std::memory_order_acquire))
+            return false;
+        p_Value = m_Elements[head & (Capacity - 1)];
+        m_Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+  private:
+    TKit::Array<T, Capacity> m_Elements{};
+
+    // Counters wrap around freely. Each is written by one side only, so they live on separate cache lines
+    alignas(64) std::atomic<u32> m_Head{0};
+    alignas(64) std::atomic<u32> m_Tail{0};
+};
+} // namespace Driz
@@ -0,0 +1,158 @@
+#include "driz/core/topology.hpp"
+#include <algorithm>
+#include <thread>
+#ifdef __linux__
+#    include <pthread.h>
+#    include <sched.h>
+#    include <filesystem>
+#    include <cctype>
+#    include <cstdlib>
+#    include <fstream>
+#    include <string>
+#endif
+
+namespace Driz
+{
+u32 CpuTopology::GetDefaultWorkerCount() const noexcept
+{
+    return std::max(PerformanceCores, 1u) - 1;
+}
+u32 CpuTopology::GetPlacement(const u32 p_ThreadIndex) const noexcept
+{
+    return PlacementOrder[p_ThreadIndex % PlacementOrder.size()];
+}
+
+static CpuTopology fallbackTopology() noexcept
+{
+    CpuTopology topology{};
+    const u32 cpus = std::clamp(std::thread::hardware_concurrency(), 1u, MaxLogicalCpus);
+    for (u32 i = 0; i < cpus; ++i)
+        topology.PlacementOrder.push_back(i);
+    topology.LogicalCores = cpus;
+    topology.PhysicalCores = cpus;
+    topology.PerformanceCores = cpus;
+    return topology;
+}
+
+#ifdef __linux__
+namespace fs = std::filesystem;
+
+static bool readLine(const fs::path &p_Path, std::string &p_Line) noexcept
+{
+    std::ifstream file{p_Path};
+    return file && std::getline(file, p_Line);
+}
+
+// Parses the kernel's cpu list format, such as "0-3,8,10-11"
+template <typename F> static void forEachInCpuList(const std::string &p_List, F &&p_Function) noexcept
+{
+    const char *c = p_List.c_str();
+    while (*c != '\0')
+    {
+        char *end;
+        const u32 first = static_cast<u32>(std::strtoul(c, &end, 10));
+        if (end == c)
+            return;
+        u32 last = first;
+        c = end;
+        if (*c == '-')
+        {
+            last = static_cast<u32>(std::strtoul(c + 1, &end, 10));
+            c = end;
+        }
+        for (u32 cpu = first; cpu <= last && cpu < MaxLogicalCpus; ++cpu)
+            p_Function(cpu);
+        if (*c == ',')
+            ++c;
+        else
+            return;
+    }
+}
+
+// Relative speed of a CPU. The kernel's capacity is the most reliable on hybrid parts, and the maximum frequency is
+// a good stand-in when it is missing. Zero means unknown
+static u64 readCpuSpeed(const fs::path &p_Cpu) noexcept
+{
+    std::string line;
+    if (readLine(p_Cpu / "cpu_capacity", line) || readLine(p_Cpu / "cpufreq" / "cpuinfo_max_freq", line))
+        return std::strtoull(line.c_str(), nullptr, 10);
+    return 0;
+}
+
+CpuTopology DetectCpuTopology() noexcept
+{
+    const fs::path root = "/sys/devices/system/cpu";
+    std::string line;
+    if (!readLine(root / "online", line))
+        return fallbackTopology();
+
+    struct LogicalCpu
+    {
+        u32 Id;
+        u64 Speed;
+        bool Primary;
+    };
+    TKit::StaticArray<LogicalCpu, MaxLogicalCpus> cpus;
+    forEachInCpuList(line, [&root, &cpus](const u32 p_Cpu) {
+        const fs::path path = root / ("cpu" + std::to_string(p_Cpu));
+        std::string siblings;
+        u32 firstSibling = p_Cpu;
+        if (readLine(path / "topology" / "thread_siblings_list", siblings))
+            forEachInCpuList(siblings, [&firstSibling](const u32 p_Sibling) {
+                firstSibling = std::min(firstSibling, p_Sibling);
+            });
+        cpus.push_back(LogicalCpu{p_Cpu, readCpuSpeed(path), firstSibling == p_Cpu});
+    });
+    if (cpus.empty())
+        return fallbackTopology();
+
+    std::stable_sort(cpus.begin(), cpus.end(), [](const LogicalCpu &p_Left, const LogicalCpu &p_Right) {
+        if (p_Left.Primary != p_Right.Primary)
+            return p_Left.Primary;
+        return p_Left.Speed > p_Right.Speed;
+    });
+
+    CpuTopology topology{};
+    const u64 fastest = cpus[0].Speed;
+    for (const LogicalCpu &cpu : cpus)
+    {
+        topology.PlacementOrder.push_back(cpu.Id);
+        if (!cpu.Primary)
+            continue;
+        ++topology.PhysicalCores;
+        if (cpu.Speed * 5 >= fastest * 4)
+            ++topology.PerformanceCores;
+    }
+    topology.LogicalCores = cpus.size();
+
+    u32 nodes = 0;
+    std::error_code error;
+    for (const fs::directory_entry &entry : fs::directory_iterator{"/sys/devices/system/node", error})
+    {
+        const std::string name = entry.path().filename().string();
+        if (name.size() > 4 && name.starts_with("node") && std::isdigit(name[4]))
+            ++nodes;
+    }
+    topology.NumaNodes = std::max(nodes, 1u);
+    return topology;
+}
+
+bool PinCurrentThread(const u32 p_Cpu) noexcept
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(p_Cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+#else
+CpuTopology DetectCpuTopology() noexcept
+{
+    return fallbackTopology();
+}
+
+bool PinCurrentThread(const u32) noexcept
+{
+    return false;
+}
+#endif
+} // namespace Driz
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "driz/core/alias.hpp"
+#include "tkit/container/static_array.hpp"
+
+namespace Driz
+{
+constexpr u32 MaxLogicalCpus = 1024;
+
+// The machine's CPU layout as exposed by Linux under /sys/devices/system/cpu. On other platforms, or when sysfs is
+// unreadable, every logical CPU reported by the standard library is treated as its own performance core
+struct CpuTopology
+{
+    // Logical CPUs in the order threads should be placed on them: one per physical core, fastest cores first, then
+    // the remaining hyperthread siblings in the same order
+    TKit::StaticArray<u32, MaxLogicalCpus> PlacementOrder;
+
+    u32 LogicalCores = 0;
+    u32 PhysicalCores = 0;
+    // Physical cores within 80% of the fastest one. Anything below is considered an efficiency core
+    u32 PerformanceCores = 0;
+    u32 NumaNodes = 1;
+
+    // One thread per performance core, the calling thread included
+    u32 GetDefaultWorkerCount() const noexcept;
+    u32 GetPlacement(u32 p_ThreadIndex) const noexcept;
+};
+
+CpuTopology DetectCpuTopology() noexcept;
+
+// Restricts the calling thread to a single logical CPU. Returns false if the platform does not support it
+bool PinCurrentThread(u32 p_Cpu) noexcept;
+} // namespace Driz
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "driz/core/alias.hpp"
+#include "tkit/container/array.hpp"
+#include <atomic>
+
+namespace Driz
+{
+// Hands the latest version of a value from one writer thread to one reader thread without locks. Each side owns one
+// of the three buffers and the third one is exchanged between them, so neither ever waits for the other. Versions
+// the reader does not get to see in time are simply skipped, and buffers keep their allocations across exchanges
+template <typename T> class TripleBuffer
+{
+  public:
+    // Writer side. The buffer may still hold an old version, which is useful to reuse its storage
+    T &GetWriteBuffer() noexcept
+    {
+        return m_Buffers[m_Write];
+    }
+    void Publish() noexcept
+    {
+        m_Write = m_Middle.exchange(m_Write | s_Fresh, std::memory_order_acq_rel) & s_IndexMask;
+    }
+
+    // Reader side. Picks up the latest published version, if there is one the reader has not seen yet
+    bool Update() noexcept
+    {
+        if ((m_Middle.load(std::memory_order_relaxed) & s_Fresh) == 0)
+            return false;
+        m_Read = m_Middle.exchange(m_Read, std::memory_order_acq_rel) & s_IndexMask;
+        return true;
+    }
+    T &GetReadBuffer() noexcept
+    {
+        return m_Buffers[m_Read];
+    }
+    const T &GetReadBuffer() const noexcept
+    {
+        return m_Buffers[m_Read];
+    }
+
+  private:
+    static constexpr u8 s_IndexMask = 0x3;
+    static constexpr u8 s_Fresh = 0x4;
+
+    TKit::Array<T, 3> m_Buffers{};
+
+    // Each index is only touched by its own side, so they are kept away from each other and from the shared one
+    alignas(64) u8 m_Write = 0;
+    alignas(64) std::atomic<u8> m_Middle{1};
+    alignas(64) u8 m_Read = 2;
+};
+} // namespace Driz
@@ -0,0 +1,101 @@
+#include "driz/core/worker_team.hpp"
+#if defined(__x86_64__) || defined(_M_X64)
+#    include <immintrin.h>
+#endif
+
+namespace Driz
+{
+// Roughly a few microseconds of polling, which covers the gap between consecutive jobs of a step
+static constexpr u32 s_SpinCount = 4096;
+
+static void cpuRelax() noexcept
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+WorkerTeam::WorkerTeam(const u32 p_WorkerCount, const CpuTopology *p_Topology) noexcept
+    : m_WorkerCount(p_WorkerCount)
+{
+    for (u32 i = 0; i < m_WorkerCount; ++i)
+    {
+        const u32 cpu = p_Topology ? p_Topology->GetPlacement(i + 1) : UINT32_MAX;
+        m_Workers[i] = std::thread([this, i, cpu] {
+            if (cpu != UINT32_MAX)
+                PinCurrentThread(cpu);
+            workerLoop(i + 1);
+        });
+    }
+}
+WorkerTeam::~WorkerTeam() noexcept
+{
+    m_Stop.store(true, std::memory_order_relaxed);
+    m_Pending.store(m_WorkerCount, std::memory_order_relaxed);
+    m_Generation.fetch_add(1, std::memory_order_release);
+    m_Generation.notify_all();
+    for (u32 i = 0; i < m_WorkerCount; ++i)
+        m_Workers[i].join();
+}
+
+void WorkerTeam::SetSpinning(const bool p_Spinning) noexcept
+{
+    m_Spinning.store(p_Spinning, std::memory_order_relaxed);
+}
+u32 WorkerTeam::GetWorkerCount() const noexcept
+{
+    return m_WorkerCount;
+}
+
+void WorkerTeam::dispatch() noexcept
+{
+    m_Pending.store(m_WorkerCount, std::memory_order_relaxed);
+    m_Generation.fetch_add(1, std::memory_order_release);
+    m_Generation.notify_all();
+}
+
+void WorkerTeam::wait() noexcept
+{
+    u32 spins = 0;
+    for (u32 pending = m_Pending.load(std::memory_order_acquire); pending != 0;
+         pending = m_Pending.load(std::memory_order_acquire))
+    {
+        if (++spins < s_SpinCount)
+            cpuRelax();
+        else
+            m_Pending.wait(pending, std::memory_order_acquire);
+    }
+}
+
+void WorkerTeam::workerLoop(const u32 p_ThreadIndex) noexcept
+{
+    u32 seen = 0;
+    for (;;)
+    {
+        u32 spins = 0;
+        u32 generation = m_Generation.load(std::memory_order_acquire);
+        for (; generation == seen; generation = m_Generation.load(std::memory_order_acquire))
+        {
+            if (++spins < s_SpinCount)
+                cpuRelax();
+            // Inside a parallel region workers stay awake, but give their core away in case threads outnumber cores
+            else if (m_Spinning.load(std::memory_order_relaxed))
+                std::this_thread::yield();
+            else
+            {
+                m_Generation.wait(seen, std::memory_order_acquire);
+                spins = 0;
+            }
+        }
+        seen = generation;
+        if (m_Stop.load(std::memory_order_relaxed))
+            return;
+
+        m_Invoke(m_Job, p_ThreadIndex);
+        if (m_Pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            m_Pending.notify_one();
+    }
+}
+} // namespace Driz
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "driz/core/alias.hpp"
+#include "driz/core/topology.hpp"
+#include "tkit/container/array.hpp"
+#include "tkit/multiprocessing/thread_pool.hpp"
+#include <atomic>
+#include <thread>
+#include <type_traits>
+
+namespace Driz
+{
+// A fixed set of threads that run every job together with the calling thread. There are no tasks to allocate or
+// submit: a job is published through a generation counter, which workers spin on for a short while before parking.
+// While spinning is requested, they never park, so back to back jobs start with no wakeup at all
+class WorkerTeam
+{
+  public:
+    // If p_Topology is not null, each worker is pinned to the CPU the topology assigns to its thread index
+    explicit WorkerTeam(u32 p_WorkerCount, const CpuTopology *p_Topology = nullptr) noexcept;
+    ~WorkerTeam() noexcept;
+
+    WorkerTeam(const WorkerTeam &) = delete;
+    WorkerTeam &operator=(const WorkerTeam &) = delete;
+
+    // Calls p_Function(threadIndex) once on every worker and once on the calling thread, with index 0, and returns
+    // when all of them are done
+    template <typename F> void Run(F &&p_Function) noexcept
+    {
+        using Function = std::remove_reference_t<F>;
+        m_Job = const_cast<void *>(static_cast<const void *>(&p_Function));
+        m_Invoke = [](void *p_Job, const u32 p_ThreadIndex) { (*static_cast<Function *>(p_Job))(p_ThreadIndex); };
+
+        dispatch();
+        p_Function(0);
+        wait();
+    }
+
+    void SetSpinning(bool p_Spinning) noexcept;
+    u32 GetWorkerCount() const noexcept;
+
+  private:
+    void dispatch() noexcept;
+    void wait() noexcept;
+    void workerLoop(u32 p_ThreadIndex) noexcept;
+
+    TKit::Array<std::thread, TKIT_THREAD_POOL_MAX_THREADS> m_Workers;
+    u32 m_WorkerCount;
+
+    void *m_Job = nullptr;
+    void (*m_Invoke)(void *, u32) = nullptr;
+
+    // Kept on separate cache lines, as workers poll the first and write the second
+    alignas(64) std::atomic<u32> m_Generation{0};
+    alignas(64) std::atomic<u32> m_Pending{0};
+    std::atomic<bool> m_Spinning{false};
+    std::atomic<bool> m_Stop{false};
+};
+} // namespace Driz
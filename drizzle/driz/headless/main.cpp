@@ -0,0 +1,198 @@
+#include "driz/core/report.hpp"
+#include "driz/simulation/arguments.hpp"
+#include "driz/simulation/solver.hpp"
+#include "driz/simulation/shape.hpp"
+#include "driz/simulation/telemetry.hpp"
+#include "tkit/profiling/clock.hpp"
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+namespace Driz
+{
+struct HeadlessOptions
+{
+    std::optional<std::string> TimingsPath;
+    std::optional<TelemetrySettings> Telemetry;
+    u32 Steps;
+    u32 WarmupSteps;
+    u32 Lattice;
+    f32 DeltaTime;
+};
+
+// Per substep samples of each step phase, in milliseconds. The last column holds the whole substep
+using PhaseSamples = TKit::Array<TKit::DynamicArray<f64>, StepPhaseCount + 1>;
+
+static void recordTimings(const StepTimings &p_Timings, PhaseSamples &p_Samples) noexcept
+{
+    for (u32 i = 0; i < StepPhaseCount; ++i)
+        p_Samples[i].push_back(static_cast<f64>(p_Timings.Phases[i].AsMilliseconds()));
+    p_Samples[StepPhaseCount].push_back(static_cast<f64>(p_Timings.GetTotal().AsMilliseconds()));
+}
+
+static void writeTimings(std::ostream &p_Stream, const Dimension p_Dim, const u32 p_Particles,
+                         PhaseSamples &p_Samples) noexcept
+{
+    p_Stream << "{\n  ";
+    WriteReportContext(p_Stream);
+    p_Stream << ",\n  \"dim\": " << static_cast<u32>(p_Dim) << ", \"particles\": " << p_Particles
+             << ", \"threads\": " << Core::GetThreadCount() << ", \"substeps\": " << p_Samples[0].size()
+             << ",\n  \"phases\": {";
+    for (u32 i = 0; i <= StepPhaseCount; ++i)
+    {
+        const SampleStatistics stats = ComputeStatistics(p_Samples[i]);
+        const char *name = i < StepPhaseCount ? ToString(static_cast<StepPhase>(i)) : "Step";
+        p_Stream << (i == 0 ? "\n" : ",\n") << "    \"" << name << "\": {\"mean_ms\": " << stats.Mean
+                 << ", \"median_ms\": " << stats.Median << ", \"min_ms\": " << stats.Min
+                 << ", \"stddev_ms\": " << stats.StdDev << "}";
+    }
+    p_Stream << "\n  }\n}" << std::endl;
+}
+
+// Same layout as the default state of the intro layer: a centered lattice, 0.4 smoothing radii apart
+template <Dimension D>
+static SimulationState<D> createLatticeState(const SimulationSettings &p_Settings, const u32 p_Lattice) noexcept
+{
+    SimulationState<D> state{};
+    const f32 separation = 0.4f * p_Settings.SmoothingRadius;
+    const uvec<D> counts{p_Lattice};
+    const fvec<D> midPoint = 0.5f * separation * fvec<D>{counts};
+    GenerateLattice<D>(counts, separation, -midPoint, state.Positions);
+    state.Velocities.assign(state.Positions.size(), fvec<D>{0.f});
+    return state;
+}
+
+template <Dimension D>
+static void run(const SimulationArguments &p_Arguments, const std::optional<SimulationState<D>> &p_State,
+                const HeadlessOptions &p_Options) noexcept
+{
+    const SimulationState<D> state =
+        p_State ? p_State->Clone() : createLatticeState<D>(p_Arguments.Settings, p_Options.Lattice);
+    Solver<D> solver{p_Arguments.Settings, state};
+    const u32 particles = solver.GetParticleCount();
+
+    // Warm up steps are recorded too, as telemetry is meant to show the whole run
+    std::unique_ptr<TelemetryRecorder> telemetry;
+    if (p_Options.Telemetry)
+    {
+        telemetry = std::make_unique<TelemetryRecorder>(*p_Options.Telemetry);
+        if (telemetry->IsOpen())
+            solver.SetTelemetry(telemetry.get());
+        else
+            std::cerr << "Could not open '" << p_Options.Telemetry->Path << "', telemetry disabled" << std::endl;
+    }
+
+    // Warm up steps let the grid order and the scratch memory settle before anything is timed
+    Core::BeginParallelRegion();
+    for (u32 i = 0; i < p_Options.WarmupSteps; ++i)
+        solver.Advance(p_Options.DeltaTime, [&solver](const f32 p_DeltaTime) { solver.Step(p_DeltaTime); });
+
+    // Substeps are what actually costs time, so they are the ones counted
+    PhaseSamples samples{};
+    const bool timed = p_Options.TimingsPath.has_value();
+    u64 steps = 0;
+    const TKit::Clock clock{};
+    for (u32 i = 0; i < p_Options.Steps; ++i)
+    {
+        const TimestepStats &stats =
+            solver.Advance(p_Options.DeltaTime, [&solver, &samples, timed](const f32 p_DeltaTime) {
+                solver.Step(p_DeltaTime);
+                if (timed)
+                    recordTimings(solver.GetStepTimings(), samples);
+            });
+        steps += stats.Substeps;
+    }
+    const f32 seconds = clock.GetElapsed().AsSeconds();
+    Core::EndParallelRegion();
+
+    const f64 stepsPerSecond = static_cast<f64>(steps) / seconds;
+    std::cout << "Particles: " << particles << " (" << solver.GetParticleCount() << " at the end)\n";
+    std::cout << "Threads: " << Core::GetThreadCount() << '\n';
+    std::cout << "Steps: " << steps << " in " << seconds << " s\n";
+    std::cout << "Steps per second: " << stepsPerSecond << '\n';
+    std::cout << "Particle steps per second: " << stepsPerSecond * particles << std::endl;
+
+    if (timed)
+    {
+        std::ofstream file{*p_Options.TimingsPath};
+        writeTimings(file, D, particles, samples);
+    }
+    if (telemetry && telemetry->IsOpen())
+        std::cout << "Telemetry: " << telemetry->GetRecordedCount() << " steps recorded, "
+                  << telemetry->GetDroppedCount() << " dropped" << std::endl;
+}
+} // namespace Driz
+
+int main(int argc, char **argv)
+{
+    using namespace Driz;
+    argparse::ArgumentParser parser{"drizzle-headless", "1.0", argparse::default_arguments::all};
+    parser.add_description("Runs the simulation without a window, as fast as possible, and reports its throughput.");
+    parser.add_argument("-n", "--steps")
+        .scan<'u', u32>()
+        .default_value(1000u)
+        .help("The amount of steps to run. With an adaptive time step, each may be split into several substeps.");
+    parser.add_argument("--warmup-steps")
+        .scan<'u', u32>()
+        .default_value(0u)
+        .help("Steps run before the measured ones, left out of every reported figure.");
+    parser.add_argument("--timings")
+        .help("Path of a JSON file where the mean, median, minimum and standard deviation of the time spent in each "
+              "step phase are written, in milliseconds per substep.");
+    parser.add_argument("--telemetry")
+        .help("Path of a file where the phase timings, particle, cell and pair counts and cell clashes of every step "
+              "are streamed while running. CSV, or JSON Lines if the path ends with .json or .jsonl.");
+    parser.add_argument("--telemetry-interval")
+        .scan<'f', f32>()
+        .default_value(0.1f)
+        .help("Seconds between telemetry flushes to the file. Must be positive.");
+    parser.add_argument("--clash-interval")
+        .scan<'u', u32>()
+        .default_value(64u)
+        .help("Steps between cell clash counts in the telemetry. 0 disables them.");
+    parser.add_argument("--delta-time").scan<'f', f32>().default_value(1.f / 60.f).help("The time step.");
+    parser.add_argument("--lattice")
+        .scan<'u', u32>()
+        .help("Particles per axis of the lattice simulated when no state is given. Defaults to 60 in 2D and 20 in "
+              "3D.");
+    AddSimulationArguments(parser);
+
+    try
+    {
+        parser.parse_args(argc, argv);
+    }
+    catch (const std::exception &err)
+    {
+        std::cerr << err.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    SimulationArguments arguments{};
+    ReadSimulationArguments(parser, arguments);
+
+    HeadlessOptions options;
+    options.TimingsPath = parser.present("--timings");
+    if (const auto path = parser.present("--telemetry"))
+    {
+        TelemetrySettings &telemetry = options.Telemetry.emplace();
+        telemetry.Path = *path;
+        telemetry.FlushInterval = parser.get<f32>("--telemetry-interval");
+        if (!(telemetry.FlushInterval > 0.f))
+        {
+            std::cerr << "The telemetry interval must be positive" << std::endl;
+            return EXIT_FAILURE;
+        }
+        telemetry.ClashInterval = parser.get<u32>("--clash-interval");
+    }
+    options.Steps = parser.get<u32>("--steps");
+    options.WarmupSteps = parser.get<u32>("--warmup-steps");
+    options.DeltaTime = parser.get<f32>("--delta-time");
+    options.Lattice = parser.present<u32>("--lattice").value_or(arguments.Dim == D2 ? 60u : 20u);
+
+    Core::Initialize(arguments.Threading);
+    if (arguments.Dim == D2)
+        run<D2>(arguments, arguments.State2, options);
+    else
+        run<D3>(arguments, arguments.State3, options);
+    Core::Terminate();
+}
@@ -2,6 +2,7 @@
 #include "driz/app/sim_layer.hpp"
 #include "driz/app/argparse.hpp"
 #include "onyx/app/app.hpp"
+#include "onyx/core/core.hpp"
 
 void SetIntroLayer(Onyx::Application &p_App, const Driz::ParseResult *p_Result) noexcept
 {
@@ -17,7 +18,8 @@ int main(int argc, char **argv)
 {
     const Driz::ParseResult *result = Driz::ParseArgs(argc, argv);
 
-    Driz::Core::Initialize();
+    Driz::Core::Initialize(result->Threading);
+    Onyx::Core::Initialize(&Driz::Core::GetThreadPool());
     {
         Onyx::Window::Specs specs{};
         specs.Name = "Drizzle";
@@ -43,6 +45,7 @@ int main(int argc, char **argv)
         else
             app.Run();
     }
+    Onyx::Core::Terminate();
     Driz::Core::Terminate();
 
     delete result;
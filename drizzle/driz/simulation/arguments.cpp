@@ -0,0 +1,108 @@
+#include "driz/simulation/arguments.hpp"
+#include "driz/core/serialization.hpp"
+#include "tkit/reflection/driz/simulation/settings.hpp"
+#include "tkit/serialization/yaml/container.hpp"
+#include "tkit/serialization/yaml/glm.hpp"
+
+namespace Driz
+{
+static std::string cliName(const char *p_Name) noexcept
+{
+    std::string result{"--"};
+    for (const char *c = p_Name; *c != '\0'; ++c)
+    {
+        if (std::isupper(*c) && c != p_Name && !std::isupper(c[-1]))
+            result.push_back('-');
+
+        result.push_back(std::tolower(*c));
+    }
+
+    return result;
+}
+
+void AddSimulationArguments(argparse::ArgumentParser &p_Parser) noexcept
+{
+    p_Parser.add_argument("--settings")
+        .help("A path pointing to a .yaml file with simulation settings. The file must be compliant with the"
+              "program's structure to work.");
+    p_Parser.add_argument("--state").help(
+        "A path pointing to a .yaml file with the simulation state. The file must be compliant with the program's "
+        "structure to work. Trying to load a 2D state in a 3D simulation and vice versa will result in an error.");
+
+    p_Parser.add_argument("--threads")
+        .scan<'u', u32>()
+        .help("The amount of worker threads besides the main one. If not specified, one thread per performance core "
+              "is used, as detected from the CPU topology.");
+    p_Parser.add_argument("--no-pin").flag().help(
+        "Do not pin threads to physical cores. Let the operating system schedule them instead.");
+    p_Parser.add_argument("--first-touch")
+        .flag()
+        .help("Have each worker thread first touch its share of the particle buffers so that they are allocated in its "
+              "NUMA node. Only useful on multi-socket machines with pinned threads.");
+
+    auto &group = p_Parser.add_mutually_exclusive_group(true);
+    group.add_argument("--2-dim").flag().help("Run the simulation in 2D mode.");
+    group.add_argument("--3-dim").flag().help("Run the simulation in 3D mode.");
+
+    TKit::Reflect<SimulationSettings>::ForEachCommandLineField([&p_Parser](const auto &p_Field) {
+        using Field = TKit::NoCVRef<decltype(p_Field)>;
+        using Type = typename Field::Type;
+
+        argparse::Argument &arg = p_Parser.add_argument(cliName(p_Field.Name));
+        if constexpr (std::is_same_v<Type, f32>)
+            arg.scan<'f', f32>();
+        else if constexpr (std::is_same_v<Type, u32>)
+            arg.scan<'u', u32>();
+
+        if constexpr (std::is_same_v<Type, bool>)
+            arg.scan<'i', i32>().help(TKIT_FORMAT(
+                "'SimulationSettings' boolean field. You may specify it with an integer (0 or 1)."));
+        else if constexpr (std::is_enum_v<Type>)
+        {
+            using EType = std::underlying_type_t<Type>;
+            arg.scan<'i', EType>().help(
+                TKIT_FORMAT("'SimulationSettings' enum field of type '{}'. You may specify it with an integer.",
+                            p_Field.TypeString));
+        }
+        else
+            arg.help(TKIT_FORMAT("'SimulationSettings' field of type '{}'.", p_Field.TypeString));
+    });
+}
+
+void ReadSimulationArguments(const argparse::ArgumentParser &p_Parser, SimulationArguments &p_Arguments) noexcept
+{
+    SimulationSettings settings{};
+    const bool is2D = p_Parser.get<bool>("--2-dim");
+    p_Arguments.Dim = is2D ? D2 : D3;
+
+    if (const auto path = p_Parser.present("--settings"))
+        settings = TKit::Yaml::Deserialize<SimulationSettings>(*path);
+
+    if (const auto path = p_Parser.present("--state"))
+    {
+        if (is2D)
+            p_Arguments.State2 = TKit::Yaml::Deserialize<SimulationState<D2>>(*path);
+        else
+            p_Arguments.State3 = TKit::Yaml::Deserialize<SimulationState<D3>>(*path);
+    }
+
+    if (const auto threads = p_Parser.present<u32>("--threads"))
+        p_Arguments.Threading.WorkerCount = *threads;
+    p_Arguments.Threading.PinThreads = !p_Parser.get<bool>("--no-pin");
+    p_Arguments.Threading.FirstTouch = p_Parser.get<bool>("--first-touch");
+
+    TKit::Reflect<SimulationSettings>::ForEachCommandLineField([&p_Parser, &settings](const auto &p_Field) {
+        using Field = TKit::NoCVRef<decltype(p_Field)>;
+        using Type = typename Field::Type;
+        if constexpr (std::is_same_v<Type, bool>)
+        {
+            if (const auto value = p_Parser.present<i32>(cliName(p_Field.Name)))
+                p_Field.Set(settings, *value != 0);
+        }
+        else if (const auto value = p_Parser.present<Type>(cliName(p_Field.Name)))
+            p_Field.Set(settings, *value);
+    });
+
+    p_Arguments.Settings = settings;
+}
+} // namespace Driz
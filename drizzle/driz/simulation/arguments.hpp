@@ -0,0 +1,24 @@
+#pragma once
+
+#include "driz/simulation/settings.hpp"
+#include <argparse/argparse.hpp>
+#include <optional>
+
+namespace Driz
+{
+// Command line options shared by every executable: settings and state files, threading, the dimension and each
+// setting of the "CommandLine" group
+struct SimulationArguments
+{
+    SimulationSettings Settings;
+    ThreadingSpecs Threading;
+    std::optional<SimulationState<D2>> State2;
+    std::optional<SimulationState<D3>> State3;
+
+    Dimension Dim;
+};
+
+void AddSimulationArguments(argparse::ArgumentParser &p_Parser) noexcept;
+// The parser must have already parsed the command line. Settings and state files are loaded here
+void ReadSimulationArguments(const argparse::ArgumentParser &p_Parser, SimulationArguments &p_Arguments) noexcept;
+} // namespace Driz
@@ -1,5 +1,6 @@
 #include "driz/simulation/kernel.hpp"
 #include "driz/core/glm.hpp"
+#include "driz/core/core.hpp"
 
 namespace Driz
 {
@@ -60,94 +61,152 @@ template <Dimension D> static f32 wendlandC4Sigma(const f32 p_Radius) noexcept
         return 495.f / (256.f * glm::pi<f32>() * bigR * p_Radius);
 }
 
+// Radius based entry points, which compute the normalization on every call. The formulas only live in kernel.hpp
 template <Dimension D> f32 Kernel<D>::Spiky2(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = 1.f - p_Distance / p_Radius;
-    return spiky2Sigma<D>(p_Radius) * q * q;
+    return EvaluateKernel<KernelType::Spiky2>(spiky2Sigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
 }
 template <Dimension D> f32 Kernel<D>::Spiky2Slope(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = 1.f - p_Distance / p_Radius;
-    return -2.f * spiky2Sigma<D>(p_Radius) * q / p_Radius;
+    return EvaluateKernelSlope<KernelType::Spiky2>(spiky2Sigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
 }
 
 template <Dimension D> f32 Kernel<D>::Spiky3(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = 1.f - p_Distance / p_Radius;
-    return spiky3Sigma<D>(p_Radius) * q * q * q;
+    return EvaluateKernel<KernelType::Spiky3>(spiky3Sigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
 }
 template <Dimension D> f32 Kernel<D>::Spiky3Slope(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = 1.f - p_Distance / p_Radius;
-    return -3.f * spiky3Sigma<D>(p_Radius) * q * q / p_Radius;
+    return EvaluateKernelSlope<KernelType::Spiky3>(spiky3Sigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
 }
 
 template <Dimension D> f32 Kernel<D>::Spiky5(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = 1.f - p_Distance / p_Radius;
-    return spiky5Sigma<D>(p_Radius) * q * q * q * q * q;
+    return EvaluateKernel<KernelType::Spiky5>(spiky5Sigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
 }
 template <Dimension D> f32 Kernel<D>::Spiky5Slope(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = 1.f - p_Distance / p_Radius;
-    return -5.f * spiky5Sigma<D>(p_Radius) * q * q * q * q / p_Radius;
+    return EvaluateKernelSlope<KernelType::Spiky5>(spiky5Sigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
 }
 
 template <Dimension D> f32 Kernel<D>::Poly6(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = 1.f - p_Distance * p_Distance / (p_Radius * p_Radius);
-    return poly6Sigma<D>(p_Radius) * q * q * q;
+    return EvaluateKernel<KernelType::Poly6>(poly6Sigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
 }
 template <Dimension D> f32 Kernel<D>::Poly6Slope(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = p_Distance / p_Radius;
-    const f32 q2 = 1.f - q * q;
-    return -6.f * q * poly6Sigma<D>(p_Radius) * q2 * q2 / p_Radius;
+    return EvaluateKernelSlope<KernelType::Poly6>(poly6Sigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
 }
 
 template <Dimension D> f32 Kernel<D>::CubicSpline(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = 2.f * p_Distance / p_Radius;
-    if (q <= 1.f)
-        return cubicSigma<D>(p_Radius) * (1.f - 1.5f * q * q + 0.75f * q * q * q);
-
-    const f32 q2 = 2.f - q;
-    return 0.25f * cubicSigma<D>(p_Radius) * q2 * q2 * q2;
+    return EvaluateKernel<KernelType::CubicSpline>(cubicSigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
 }
 template <Dimension D> f32 Kernel<D>::CubicSplineSlope(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = 2.f * p_Distance / p_Radius;
-    if (q <= 1.f)
-        return 3.f * cubicSigma<D>(p_Radius) * q * (0.75f * q - 1.f);
-
-    const f32 q2 = 2.f - q;
-    return -0.75f * cubicSigma<D>(p_Radius) * q2 * q2;
+    return EvaluateKernelSlope<KernelType::CubicSpline>(cubicSigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
 }
 
 template <Dimension D> f32 Kernel<D>::WendlandC2(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = 2.f * p_Distance / p_Radius;
-    const f32 q2 = 1.f - 0.5f * q;
-    return wendlandC2Sigma<D>(p_Radius) * q2 * q2 * q2 * q2 * (2.f * q + 1.f);
+    return EvaluateKernel<KernelType::WendlandC2>(wendlandC2Sigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
 }
 template <Dimension D> f32 Kernel<D>::WendlandC2Slope(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = 2.f * p_Distance / p_Radius;
-    const f32 q2 = 1.f - 0.5f * q;
-    return -5.f * q * q2 * q2 * q2 * wendlandC2Sigma<D>(p_Radius);
+    return EvaluateKernelSlope<KernelType::WendlandC2>(wendlandC2Sigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
 }
 
 template <Dimension D> f32 Kernel<D>::WendlandC4(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = 2.f * p_Distance / p_Radius;
-    const f32 q2 = 1.f - 0.5f * q;
-    return wendlandC4Sigma<D>(p_Radius) * q2 * q2 * q2 * q2 * q2 * q2 * (35.f * q * q / 12.f + 3 * q + 1.f);
+    return EvaluateKernel<KernelType::WendlandC4>(wendlandC4Sigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
 }
 template <Dimension D> f32 Kernel<D>::WendlandC4Slope(const f32 p_Radius, const f32 p_Distance) noexcept
 {
-    const f32 q = 2.f * p_Distance / p_Radius;
-    const f32 q2 = 1.f - 0.5f * q;
-    return -wendlandC4Sigma<D>(p_Radius) * 7.f * q2 * q2 * q2 * q2 * q2 * q * (5 * q + 2.f) / 3.f;
+    return EvaluateKernelSlope<KernelType::WendlandC4>(wendlandC4Sigma<D>(p_Radius), 1.f / p_Radius, p_Distance);
+}
+
+// The kernel type is dispatched once per batch. Each case is then a straight loop over the inlined formula, which
+// every clone vectorizes for its own instruction set
+#define DRIZ_BATCH_CASE(p_Function, p_Type)                                                                            \
+    case KernelType::p_Type:                                                                                           \
+        for (u32 i = 0; i < p_Count; ++i)                                                                              \
+            p_Results[i] = p_Function<KernelType::p_Type>(p_Sigma, p_InvRadius, p_Distances[i]);                      \
+        return;
+
+#define DRIZ_BATCH_SWITCH(p_Function)                                                                                  \
+    switch (p_Type)                                                                                                    \
+    {                                                                                                                  \
+        DRIZ_BATCH_CASE(p_Function, Spiky2)                                                                            \
+        DRIZ_BATCH_CASE(p_Function, Spiky3)                                                                            \
+        DRIZ_BATCH_CASE(p_Function, Spiky5)                                                                            \
+        DRIZ_BATCH_CASE(p_Function, Poly6)                                                                             \
+        DRIZ_BATCH_CASE(p_Function, CubicSpline)                                                                       \
+        DRIZ_BATCH_CASE(p_Function, WendlandC2)                                                                        \
+        DRIZ_BATCH_CASE(p_Function, WendlandC4)                                                                        \
+    }
+
+DRIZ_SIMD_CLONES static void evaluateBatch(const KernelType p_Type, const f32 p_Sigma, const f32 p_InvRadius,
+                                           const f32 *p_Distances, f32 *p_Results, const u32 p_Count) noexcept
+{
+    DRIZ_BATCH_SWITCH(EvaluateKernel)
+}
+DRIZ_SIMD_CLONES static void evaluateSlopeBatch(const KernelType p_Type, const f32 p_Sigma, const f32 p_InvRadius,
+                                                const f32 *p_Distances, f32 *p_Results, const u32 p_Count) noexcept
+{
+    DRIZ_BATCH_SWITCH(EvaluateKernelSlope)
+}
+
+#undef DRIZ_BATCH_SWITCH
+#undef DRIZ_BATCH_CASE
+
+template <Dimension D> KernelParameters Kernel<D>::CreateParameters(const f32 p_Radius) noexcept
+{
+    KernelParameters parameters;
+    parameters.Radius = p_Radius;
+    parameters.InvRadius = 1.f / p_Radius;
+    parameters.Sigmas[static_cast<u32>(KernelType::Spiky2)] = spiky2Sigma<D>(p_Radius);
+    parameters.Sigmas[static_cast<u32>(KernelType::Spiky3)] = spiky3Sigma<D>(p_Radius);
+    parameters.Sigmas[static_cast<u32>(KernelType::Spiky5)] = spiky5Sigma<D>(p_Radius);
+    parameters.Sigmas[static_cast<u32>(KernelType::Poly6)] = poly6Sigma<D>(p_Radius);
+    parameters.Sigmas[static_cast<u32>(KernelType::CubicSpline)] = cubicSigma<D>(p_Radius);
+    parameters.Sigmas[static_cast<u32>(KernelType::WendlandC2)] = wendlandC2Sigma<D>(p_Radius);
+    parameters.Sigmas[static_cast<u32>(KernelType::WendlandC4)] = wendlandC4Sigma<D>(p_Radius);
+    return parameters;
+}
+
+template <Dimension D>
+f32 Kernel<D>::Evaluate(const KernelType p_Type, const KernelParameters &p_Parameters, const f32 p_Distance) noexcept
+{
+    f32 result = 0.f;
+    DispatchKernel(p_Type, [&](const auto p_Kernel) {
+        result = EvaluateKernel<decltype(p_Kernel)::value>(p_Parameters, p_Distance);
+    });
+    return result;
+}
+template <Dimension D>
+f32 Kernel<D>::EvaluateSlope(const KernelType p_Type, const KernelParameters &p_Parameters,
+                             const f32 p_Distance) noexcept
+{
+    f32 result = 0.f;
+    DispatchKernel(p_Type, [&](const auto p_Kernel) {
+        result = EvaluateKernelSlope<decltype(p_Kernel)::value>(p_Parameters, p_Distance);
+    });
+    return result;
+}
+
+template <Dimension D>
+void Kernel<D>::Evaluate(const KernelType p_Type, const KernelParameters &p_Parameters, const f32 *p_Distances,
+                         f32 *p_Results, const u32 p_Count) noexcept
+{
+    evaluateBatch(p_Type, p_Parameters.Sigmas[static_cast<u32>(p_Type)], p_Parameters.InvRadius, p_Distances,
+                  p_Results, p_Count);
+}
+template <Dimension D>
+void Kernel<D>::EvaluateSlope(const KernelType p_Type, const KernelParameters &p_Parameters, const f32 *p_Distances,
+                              f32 *p_Results, const u32 p_Count) noexcept
+{
+    evaluateSlopeBatch(p_Type, p_Parameters.Sigmas[static_cast<u32>(p_Type)], p_Parameters.InvRadius, p_Distances,
+                       p_Results, p_Count);
 }
 
 template struct Kernel<Dimension::D2>;
@@ -2,6 +2,10 @@
 
 #include "driz/core/alias.hpp"
 #include "driz/core/dimension.hpp"
+#include "driz/core/glm.hpp"
+#include "tkit/container/array.hpp"
+#include <utility>
+#include <type_traits>
 
 namespace Driz
 {
@@ -15,9 +19,201 @@ enum class KernelType
     WendlandC2,
     WendlandC4
 };
+constexpr u32 KernelTypeCount = 7;
+
+// Everything a kernel needs that only depends on the radius, so that it is not recomputed on every evaluation
+struct KernelParameters
+{
+    f32 Radius = 0.f;
+    f32 InvRadius = 0.f;
+    TKit::Array<f32, KernelTypeCount> Sigmas{};
+};
+
+template <KernelType K> using KernelConstant = std::integral_constant<KernelType, K>;
+
+// Calls p_Function with the KernelConstant matching p_Type, turning a runtime kernel choice into a template argument
+template <typename F> void DispatchKernel(const KernelType p_Type, F &&p_Function) noexcept
+{
+    [&p_Type, &p_Function]<u32... I>(std::integer_sequence<u32, I...>) {
+        ((static_cast<u32>(p_Type) == I ? (p_Function(KernelConstant<static_cast<KernelType>(I)>{}), true) : false) ||
+         ...);
+    }(std::make_integer_sequence<u32, KernelTypeCount>{});
+}
+
+// Same as DispatchKernel, but for several kernels at once. Every combination is instantiated
+template <typename F> void DispatchKernels(F &&p_Function) noexcept
+{
+    p_Function();
+}
+template <typename F, typename... Types>
+void DispatchKernels(F &&p_Function, const KernelType p_Type, const Types... p_Types) noexcept
+{
+    DispatchKernel(p_Type, [&p_Function, p_Types...](const auto p_Kernel) {
+        DispatchKernels([&p_Function, p_Kernel](const auto... p_Kernels) { p_Function(p_Kernel, p_Kernels...); },
+                        p_Types...);
+    });
+}
+
+// Kernel formulas taking the normalization and inverse radius already computed. They do not depend on the dimension,
+// which is fully captured by the normalization
+template <KernelType K> f32 EvaluateKernel(const f32 p_Sigma, const f32 p_InvRadius, const f32 p_Distance) noexcept
+{
+    if constexpr (K == KernelType::Spiky2)
+    {
+        const f32 q = 1.f - p_Distance * p_InvRadius;
+        return p_Sigma * q * q;
+    }
+    else if constexpr (K == KernelType::Spiky3)
+    {
+        const f32 q = 1.f - p_Distance * p_InvRadius;
+        return p_Sigma * q * q * q;
+    }
+    else if constexpr (K == KernelType::Spiky5)
+    {
+        const f32 q = 1.f - p_Distance * p_InvRadius;
+        return p_Sigma * q * q * q * q * q;
+    }
+    else if constexpr (K == KernelType::Poly6)
+    {
+        const f32 q = p_Distance * p_InvRadius;
+        const f32 q2 = 1.f - q * q;
+        return p_Sigma * q2 * q2 * q2;
+    }
+    else if constexpr (K == KernelType::CubicSpline)
+    {
+        const f32 q = 2.f * p_Distance * p_InvRadius;
+        const f32 q2 = 2.f - q;
+        return q <= 1.f ? p_Sigma * (1.f - 1.5f * q * q + 0.75f * q * q * q) : 0.25f * p_Sigma * q2 * q2 * q2;
+    }
+    else if constexpr (K == KernelType::WendlandC2)
+    {
+        const f32 q = 2.f * p_Distance * p_InvRadius;
+        const f32 q2 = 1.f - 0.5f * q;
+        return p_Sigma * q2 * q2 * q2 * q2 * (2.f * q + 1.f);
+    }
+    else
+    {
+        const f32 q = 2.f * p_Distance * p_InvRadius;
+        const f32 q2 = 1.f - 0.5f * q;
+        return p_Sigma * q2 * q2 * q2 * q2 * q2 * q2 * (35.f * q * q / 12.f + 3 * q + 1.f);
+    }
+}
+template <KernelType K>
+f32 EvaluateKernelSlope(const f32 p_Sigma, const f32 p_InvRadius, const f32 p_Distance) noexcept
+{
+    if constexpr (K == KernelType::Spiky2)
+    {
+        const f32 q = 1.f - p_Distance * p_InvRadius;
+        return -2.f * p_Sigma * q * p_InvRadius;
+    }
+    else if constexpr (K == KernelType::Spiky3)
+    {
+        const f32 q = 1.f - p_Distance * p_InvRadius;
+        return -3.f * p_Sigma * q * q * p_InvRadius;
+    }
+    else if constexpr (K == KernelType::Spiky5)
+    {
+        const f32 q = 1.f - p_Distance * p_InvRadius;
+        return -5.f * p_Sigma * q * q * q * q * p_InvRadius;
+    }
+    else if constexpr (K == KernelType::Poly6)
+    {
+        const f32 q = p_Distance * p_InvRadius;
+        const f32 q2 = 1.f - q * q;
+        return -6.f * q * p_Sigma * q2 * q2 * p_InvRadius;
+    }
+    else if constexpr (K == KernelType::CubicSpline)
+    {
+        const f32 q = 2.f * p_Distance * p_InvRadius;
+        const f32 q2 = 2.f - q;
+        return q <= 1.f ? 3.f * p_Sigma * q * (0.75f * q - 1.f) : -0.75f * p_Sigma * q2 * q2;
+    }
+    else if constexpr (K == KernelType::WendlandC2)
+    {
+        const f32 q = 2.f * p_Distance * p_InvRadius;
+        const f32 q2 = 1.f - 0.5f * q;
+        return -5.f * q * q2 * q2 * q2 * p_Sigma;
+    }
+    else
+    {
+        const f32 q = 2.f * p_Distance * p_InvRadius;
+        const f32 q2 = 1.f - 0.5f * q;
+        return -p_Sigma * 7.f * q2 * q2 * q2 * q2 * q2 * q * (5 * q + 2.f) / 3.f;
+    }
+}
+
+template <KernelType K> f32 EvaluateKernel(const KernelParameters &p_Parameters, const f32 p_Distance) noexcept
+{
+    return EvaluateKernel<K>(p_Parameters.Sigmas[static_cast<u32>(K)], p_Parameters.InvRadius, p_Distance);
+}
+template <KernelType K> f32 EvaluateKernelSlope(const KernelParameters &p_Parameters, const f32 p_Distance) noexcept
+{
+    return EvaluateKernelSlope<K>(p_Parameters.Sigmas[static_cast<u32>(K)], p_Parameters.InvRadius, p_Distance);
+}
+
+// A kernel function sampled over the squared distance and linearly interpolated, so that it can be evaluated without
+// taking a square root. Squared distances must be inferior to the squared radius
+class KernelTable
+{
+  public:
+    static constexpr u32 Resolution = 2048;
+
+    // p_Function maps a squared distance to the value to tabulate
+    template <typename F> void Build(const f32 p_Radius, F &&p_Function) noexcept
+    {
+        const f32 radius2 = p_Radius * p_Radius;
+        const f32 step = radius2 / static_cast<f32>(Resolution);
+        m_Scale = 1.f / step;
+        for (u32 i = 0; i <= Resolution; ++i)
+            m_Values[i] = p_Function(step * static_cast<f32>(i));
+
+        // Linear interpolation is least accurate halfway between samples, which is where the error is measured
+        f32 maxError = 0.f;
+        f32 maxValue = 0.f;
+        for (u32 i = 0; i < Resolution; ++i)
+        {
+            const f32 distance2 = step * (static_cast<f32>(i) + 0.5f);
+            maxError = glm::max(maxError, glm::abs(Evaluate(distance2) - p_Function(distance2)));
+            maxValue = glm::max(maxValue, glm::abs(m_Values[i]));
+        }
+        m_RelativeError = maxValue > 0.f ? maxError / maxValue : 0.f;
+    }
+
+    f32 Evaluate(const f32 p_Distance2) const noexcept
+    {
+        const f32 x = p_Distance2 * m_Scale;
+        const u32 i = glm::min(static_cast<u32>(x), Resolution - 1);
+        const f32 t = x - static_cast<f32>(i);
+        return m_Values[i] + t * (m_Values[i + 1] - m_Values[i]);
+    }
+
+    // Largest interpolation error found when building, relative to the largest tabulated value
+    f32 GetRelativeError() const noexcept
+    {
+        return m_RelativeError;
+    }
+
+  private:
+    TKit::Array<f32, Resolution + 1> m_Values{};
+    f32 m_Scale = 0.f;
+    f32 m_RelativeError = 0.f;
+};
+
 // Kernels expect the distance to be inferior to the radius
 template <Dimension D> struct Kernel
 {
+    static KernelParameters CreateParameters(f32 p_Radius) noexcept;
+
+    static f32 Evaluate(KernelType p_Type, const KernelParameters &p_Parameters, f32 p_Distance) noexcept;
+    static f32 EvaluateSlope(KernelType p_Type, const KernelParameters &p_Parameters, f32 p_Distance) noexcept;
+
+    // Batched variants, vectorized with the widest instruction set the CPU supports. The solver gathers the distances
+    // of its pair batches into contiguous lanes and evaluates them through these
+    static void Evaluate(KernelType p_Type, const KernelParameters &p_Parameters, const f32 *p_Distances,
+                         f32 *p_Results, u32 p_Count) noexcept;
+    static void EvaluateSlope(KernelType p_Type, const KernelParameters &p_Parameters, const f32 *p_Distances,
+                              f32 *p_Results, u32 p_Count) noexcept;
+
     static f32 Spiky2(f32 p_Radius, f32 p_Distance) noexcept;
     static f32 Spiky2Slope(f32 p_Radius, f32 p_Distance) noexcept;
 
@@ -1,7 +1,7 @@
 #include "driz/simulation/lookup.hpp"
-#include "driz/app/visualization.hpp"
 #include "tkit/utils/hash.hpp"
 #include "tkit/profiling/macros.hpp"
+#include <bit>
 
 namespace Driz
 {
@@ -10,113 +10,575 @@ template <Dimension D> void LookupMethod<D>::SetPositions(const SimArray<fvec<D>
     m_Positions = p_Positions;
 }
 
-template <Dimension D> void LookupMethod<D>::UpdateBruteForceLookup(const f32 p_Radius) noexcept
+template <Dimension D> void LookupMethod<D>::RemapParticles(const u32 *p_NewIndices, const u32 p_Count) noexcept
+{
+    u32 kept = 0;
+    for (const u32 index : Grid.ParticleIndices)
+        if (index < p_Count && p_NewIndices[index] != UINT32_MAX)
+            Grid.ParticleIndices[kept++] = p_NewIndices[index];
+    Grid.ParticleIndices.resize(kept);
+    InvalidateNeighborLists();
+    InvalidatePairCache();
+}
+
+template <Dimension D>
+void LookupMethod<D>::UpdateBruteForceLookup(const f32 p_Radius, const bool p_MultiThread) noexcept
 {
     Radius = p_Radius;
+    m_SoAPositions.Gather(*m_Positions, nullptr, p_MultiThread);
+    m_SoAGridOrdered = false;
 }
 
-template <Dimension D> void LookupMethod<D>::UpdateGridLookup(const f32 p_Radius) noexcept
+// Past this amount of cells, a dense grid would waste too much memory and time resetting its key table
+static constexpr u64 s_MaxDenseCells = 1 << 22;
+
+template <Dimension D> void LookupMethod<D>::UpdateGridLookup(const f32 p_Radius, const bool p_MultiThread) noexcept
 {
     TKIT_PROFILE_NSCOPE("Driz::LookupMethod::UpdateGridLookup");
     if (m_Positions->empty())
         return;
+    const TKit::Clock clock{};
+    const TKit::Timespan sorting = m_Timings.Sort + m_Timings.Merge;
     Radius = p_Radius;
-    const u32 particles = m_Positions->size();
+    m_CellSize = p_Radius;
+    m_DenseCellCount = 0;
+    m_HasHalfShell = false;
+    buildGrid(m_Positions->size(), p_MultiThread);
+    buildCellCosts();
+    m_Timings.Build += clock.GetElapsed() - (m_Timings.Sort + m_Timings.Merge - sorting);
+}
 
-    struct IndexPair
+template <Dimension D>
+void LookupMethod<D>::UpdateDenseGridLookup(const f32 p_Radius, const fvec<D> &p_Min, const fvec<D> &p_Max,
+                                            const bool p_MultiThread, const bool p_HalfShell) noexcept
+{
+    TKIT_PROFILE_NSCOPE("Driz::LookupMethod::UpdateDenseGridLookup");
+    if (m_Positions->empty())
+        return;
+    const TKit::Clock clock{};
+    const TKit::Timespan sorting = m_Timings.Sort + m_Timings.Merge;
+    Radius = p_Radius;
+    m_CellSize = p_Radius;
+    m_MinCell = GetCellPosition(p_Min);
+    m_CellDimensions = GetCellPosition(p_Max) - m_MinCell + 1;
+
+    u64 cellCount = 1;
+    for (u32 i = 0; i < D; ++i)
+        cellCount *= static_cast<u64>(glm::max(m_CellDimensions[i], 0));
+
+    // Degenerate or huge boxes fall back to hashing
+    m_DenseCellCount = cellCount <= s_MaxDenseCells ? static_cast<u32>(cellCount) : 0;
+    buildGrid(m_DenseCellCount != 0 ? m_DenseCellCount : m_Positions->size(), p_MultiThread);
+    m_HasHalfShell = m_DenseCellCount != 0 && p_HalfShell;
+    if (m_HasHalfShell)
+        buildCellNeighbors(p_MultiThread);
+    buildCellCosts();
+    if (m_DenseCellCount != 0)
+        buildCellColors();
+    m_Timings.Build += clock.GetElapsed() - (m_Timings.Sort + m_Timings.Merge - sorting);
+}
+
+// The grid is built with a stable LSD radix sort over the cell keys. Each pass splits the particles in one chunk per
+// thread: chunks histogram their digits, a small serial prefix sum over (digit, chunk) assigns every chunk its output
+// slots, and chunks scatter independently. This keeps the whole build free of synchronization other than the barriers
+static constexpr u32 s_RadixBits = 11;
+static constexpr u32 s_RadixBuckets = 1 << s_RadixBits;
+
+// Particles appended since the last build are sorted on their own and merged into the already sorted remainder, which
+// costs a single pass over the rest instead of a full sort. Only worth it while the appended ones are a small fraction
+static void mergeAppended(const u32 *p_Keys, const u32 *p_Indices, u32 *p_OutKeys, u32 *p_OutIndices, u64 *p_Scratch,
+                          const u32 p_Sorted, const u32 p_Total) noexcept
+{
+    const u32 appended = p_Total - p_Sorted;
+    for (u32 i = 0; i < appended; ++i)
+        p_Scratch[i] = static_cast<u64>(p_Keys[p_Sorted + i]) << 32 | p_Indices[p_Sorted + i];
+    std::sort(p_Scratch, p_Scratch + appended);
+
+    u32 sorted = 0;
+    u32 merged = 0;
+    for (u32 i = 0; i < p_Total; ++i)
     {
-        u32 ParticleIndex;
-        u32 CellKey;
+        const bool takeAppended =
+            sorted == p_Sorted || (merged < appended && static_cast<u32>(p_Scratch[merged] >> 32) < p_Keys[sorted]);
+        if (takeAppended)
+        {
+            p_OutKeys[i] = static_cast<u32>(p_Scratch[merged] >> 32);
+            p_OutIndices[i] = static_cast<u32>(p_Scratch[merged++]);
+        }
+        else
+        {
+            p_OutKeys[i] = p_Keys[sorted];
+            p_OutIndices[i] = p_Indices[sorted++];
+        }
+    }
+}
+
+template <typename F>
+static void forEachChunk(const u32 p_Chunks, const bool p_MultiThread, F &&p_Function) noexcept
+{
+    if (p_MultiThread)
+        Core::ForEach(0, p_Chunks, [&p_Function](const u32 p_Start, const u32 p_End, const u32) {
+            for (u32 i = p_Start; i < p_End; ++i)
+                p_Function(i);
+        });
+    else
+        for (u32 i = 0; i < p_Chunks; ++i)
+            p_Function(i);
+}
+
+template <Dimension D> void LookupMethod<D>::buildGrid(const u32 p_KeyCount, const bool p_MultiThread) noexcept
+{
+    const u32 particles = m_Positions->size();
+    const u32 chunks = p_MultiThread ? Core::GetThreadCount() : 1;
+    const auto chunkStart = [particles, chunks](const u32 p_Chunk) {
+        return static_cast<u32>(static_cast<u64>(particles) * p_Chunk / chunks);
     };
 
-    Grid.CellKeyToIndex.resize(particles);
-    Grid.ParticleIndices.resize(particles);
-    Grid.Cells.clear();
+    // Only the entries set by the previous build need to be cleared, which matters for large dense grids
+    if (Grid.CellKeyToIndex.size() != p_KeyCount)
+        Grid.CellKeyToIndex.assign(p_KeyCount, UINT32_MAX);
+    else
+        for (const GridCell &cell : Grid.Cells)
+            Grid.CellKeyToIndex[cell.Key] = UINT32_MAX;
 
-    IndexPair *keys = Core::GetArena().Allocate<IndexPair>(particles);
+    // Room for the keys and indices, their sorting copies, the appended particles and the per chunk counts, plus
+    // alignment slack
+    Core::ReserveArena((6ull * particles + chunks * (s_RadixBuckets + 1ull)) * sizeof(u32) + 1024);
+    TKit::ArenaAllocator &arena = Core::GetArena();
+    u32 *keys = arena.Allocate<u32>(particles);
+    u32 *indices = arena.Allocate<u32>(particles);
+    u32 *chunkData = arena.Allocate<u32>(chunks);
 
+    // Last frame's order is used as the starting permutation. Particles rarely change cells between steps, so the
+    // input is often already sorted, and otherwise the scatters walk memory in an almost sequential fashion. Particles
+    // appended since then follow in index order
+    const u32 seeded = Grid.ParticleIndices.size() <= particles ? Grid.ParticleIndices.size() : 0;
     const auto &positions = *m_Positions;
-    for (u32 i = 0; i < particles; ++i)
+    forEachChunk(chunks, p_MultiThread, [&, seeded](const u32 p_Chunk) {
+        const u32 start = chunkStart(p_Chunk);
+        const u32 end = chunkStart(p_Chunk + 1);
+
+        u32 descents = 0;
+        for (u32 i = start; i < end; ++i)
+        {
+            const u32 index = i < seeded ? Grid.ParticleIndices[i] : i;
+            indices[i] = index;
+            keys[i] = GetCellKey(GetCellPosition(positions[index]));
+            descents += i != 0 && i != start && i < seeded && keys[i] < keys[i - 1];
+        }
+        chunkData[p_Chunk] = descents;
+    });
+
+    // Whether the seeded part is still sorted
+    bool sorted = true;
+    for (u32 i = 0; i < chunks; ++i)
     {
-        const ivec<D> cellPosition = GetCellPosition(positions[i]);
-        const u32 key = GetCellKey(cellPosition);
-        keys[i] = IndexPair{i, key};
-        Grid.CellKeyToIndex[i] = UINT32_MAX;
+        const u32 start = chunkStart(i);
+        sorted &= chunkData[i] == 0 && (start == 0 || start >= seeded || keys[start - 1] <= keys[start]);
     }
 
+    const u32 appended = particles - seeded;
+    if (sorted && appended != 0 && appended <= particles / 8)
+    {
+        TKIT_PROFILE_NSCOPE("Driz::LookupMethod::AppendedMerging");
+        const TKit::Clock clock{};
+        u32 *auxKeys = arena.Allocate<u32>(particles);
+        u32 *auxIndices = arena.Allocate<u32>(particles);
+        u64 *scratch = arena.Allocate<u64>(appended);
+        mergeAppended(keys, indices, auxKeys, auxIndices, scratch, seeded, particles);
+        std::swap(keys, auxKeys);
+        std::swap(indices, auxIndices);
+        m_Timings.Merge += clock.GetElapsed();
+    }
+    else if (!sorted || appended != 0)
     {
         TKIT_PROFILE_NSCOPE("Driz::LookupMethod::CellKeySorting");
-        std::sort(keys, keys + particles, [](const IndexPair &a, const IndexPair &b) {
-            if (a.CellKey == b.CellKey)
-                return a.ParticleIndex < b.ParticleIndex;
-            return a.CellKey < b.CellKey;
-        });
+        const TKit::Clock clock{};
+        u32 *auxKeys = arena.Allocate<u32>(particles);
+        u32 *auxIndices = arena.Allocate<u32>(particles);
+        u32 *histograms = arena.Allocate<u32>(chunks * s_RadixBuckets);
+
+        const u32 bits = static_cast<u32>(std::bit_width(p_KeyCount - 1));
+        for (u32 shift = 0; shift < bits; shift += s_RadixBits)
+        {
+            forEachChunk(chunks, p_MultiThread, [&, shift](const u32 p_Chunk) {
+                u32 *histogram = histograms + p_Chunk * s_RadixBuckets;
+                std::fill(histogram, histogram + s_RadixBuckets, 0);
+                const u32 end = chunkStart(p_Chunk + 1);
+                for (u32 i = chunkStart(p_Chunk); i < end; ++i)
+                    ++histogram[(keys[i] >> shift) & (s_RadixBuckets - 1)];
+            });
+
+            u32 offset = 0;
+            for (u32 digit = 0; digit < s_RadixBuckets; ++digit)
+                for (u32 chunk = 0; chunk < chunks; ++chunk)
+                {
+                    u32 &count = histograms[chunk * s_RadixBuckets + digit];
+                    const u32 size = count;
+                    count = offset;
+                    offset += size;
+                }
+
+            forEachChunk(chunks, p_MultiThread, [&, shift](const u32 p_Chunk) {
+                u32 *histogram = histograms + p_Chunk * s_RadixBuckets;
+                const u32 end = chunkStart(p_Chunk + 1);
+                for (u32 i = chunkStart(p_Chunk); i < end; ++i)
+                {
+                    const u32 slot = histogram[(keys[i] >> shift) & (s_RadixBuckets - 1)]++;
+                    auxKeys[slot] = keys[i];
+                    auxIndices[slot] = indices[i];
+                }
+            });
+            std::swap(keys, auxKeys);
+            std::swap(indices, auxIndices);
+        }
+        m_Timings.Sort += clock.GetElapsed();
     }
 
-    u32 prevKey = keys[0].CellKey;
-    GridCell cell{prevKey, 0, 0};
-    Grid.CellKeyToIndex[prevKey] = 0;
+    // Cells, particle indices and the key table are emitted in a single parallel pass. Each chunk owns the cells that
+    // start inside it, so their destination only depends on how many cells start in the preceding chunks
+    forEachChunk(chunks, p_MultiThread, [&](const u32 p_Chunk) {
+        const u32 end = chunkStart(p_Chunk + 1);
+        u32 cellStarts = 0;
+        for (u32 i = chunkStart(p_Chunk); i < end; ++i)
+            cellStarts += i == 0 || keys[i] != keys[i - 1];
+        chunkData[p_Chunk] = cellStarts;
+    });
 
-    for (u32 i = 0; i < particles; ++i)
+    u32 cellCount = 0;
+    for (u32 i = 0; i < chunks; ++i)
     {
-        if (keys[i].CellKey != prevKey)
+        const u32 cellStarts = chunkData[i];
+        chunkData[i] = cellCount;
+        cellCount += cellStarts;
+    }
+
+    Grid.ParticleIndices.resize(particles);
+    Grid.Cells.resize(cellCount);
+    forEachChunk(chunks, p_MultiThread, [&](const u32 p_Chunk) {
+        const u32 start = chunkStart(p_Chunk);
+        const u32 end = chunkStart(p_Chunk + 1);
+        const u32 firstCell = chunkData[p_Chunk];
+
+        u32 cellIndex = firstCell;
+        for (u32 i = start; i < end; ++i)
         {
-            cell.End = i;
-            Grid.Cells.push_back(cell);
+            Grid.ParticleIndices[i] = indices[i];
+            if (i != 0 && keys[i] == keys[i - 1])
+                continue;
 
-            Grid.CellKeyToIndex[keys[i].CellKey] = Grid.Cells.size();
-            cell.Key = keys[i].CellKey;
-            cell.Start = i;
+            if (cellIndex != firstCell)
+                Grid.Cells[cellIndex - 1].End = i;
+            Grid.CellKeyToIndex[keys[i]] = cellIndex;
+            Grid.Cells[cellIndex++] = GridCell{keys[i], i, 0};
         }
-        Grid.ParticleIndices[i] = keys[i].ParticleIndex;
-        prevKey = keys[i].CellKey;
-    }
 
-    cell.End = particles;
-    Grid.Cells.push_back(cell);
-    Core::GetArena().Reset();
+        // The last cell of the chunk may extend into the following ones
+        if (cellIndex != firstCell)
+        {
+            u32 last = end;
+            while (last < particles && keys[last] == keys[end - 1])
+                ++last;
+            Grid.Cells[cellIndex - 1].End = last;
+        }
+    });
+
+    arena.Reset();
+    m_SoAPositions.Gather(*m_Positions, &Grid.ParticleIndices, p_MultiThread);
+    m_SoAGridOrdered = true;
 }
 
-template <Dimension D> u32 LookupMethod<D>::DrawCells(Onyx::RenderContext<D> *p_Context) const noexcept
+// Dense keys are row-major cell coordinates, so neighbors are found by decoding them, without touching any particle.
+// Neighbors outside the box are skipped rather than clamped, as clamping could make a cell its own neighbor
+template <Dimension D> void LookupMethod<D>::buildCellNeighbors(const bool p_MultiThread) noexcept
 {
-    TKIT_PROFILE_NSCOPE("Driz::LookupMethod::DrawCells");
-    const auto isUnique = [](const auto it1, const auto it2, const ivec<D> &p_Position) {
-        for (auto it = it1; it != it2; ++it)
-            if (*it == p_Position)
-                return false;
-        return true;
+    TKIT_PROFILE_NSCOPE("Driz::LookupMethod::BuildCellNeighbors");
+    const HalfShellArray offsets = getHalfShellOffsets();
+    Grid.CellNeighbors.resize(Grid.Cells.size() * s_HalfShellCount);
+
+    const auto computeNeighbors = [this, &offsets](const u32 p_Start, const u32 p_End, const u32) {
+        for (u32 i = p_Start; i < p_End; ++i)
+        {
+            const ivec<D> coords = getDenseCellCoordinates(Grid.Cells[i].Key);
+            u32 *neighbors = Grid.CellNeighbors.data() + i * s_HalfShellCount;
+            for (u32 n = 0; n < s_HalfShellCount; ++n)
+            {
+                const ivec<D> neighbor = coords + offsets[n];
+                bool inside = true;
+                for (u32 j = 0; j < D; ++j)
+                    inside &= neighbor[j] >= 0 && neighbor[j] < m_CellDimensions[j];
+                neighbors[n] = inside ? Grid.CellKeyToIndex[GetCellKey(neighbor + m_MinCell)] : UINT32_MAX;
+            }
+        }
     };
 
-    const auto &positions = *m_Positions;
+    if (p_MultiThread)
+        Core::ForEach(0, Grid.Cells.size(), computeNeighbors);
+    else
+        computeNeighbors(0, Grid.Cells.size(), 0);
+}
 
-    u32 cellClashes = 0;
-    for (const GridCell &cell : Grid.Cells)
+// Cells whose coordinates are congruent modulo 3 along every axis are either the same or at least three cells apart
+// along one of them, so their neighborhoods never overlap. Cells are few compared to particles, so this stays serial
+template <Dimension D> void LookupMethod<D>::buildCellColors() noexcept
+{
+    const u32 cells = Grid.Cells.size();
+    Core::ReserveArena(cells * sizeof(u32) + 1024);
+    u32 *colors = Core::GetArena().Allocate<u32>(cells);
+    m_CellColorOffsets.fill(0);
+    for (u32 i = 0; i < cells; ++i)
+    {
+        const ivec<D> coords = getDenseCellCoordinates(Grid.Cells[i].Key);
+        u32 color = 0;
+        for (u32 j = D; j-- > 0;)
+            color = 3 * color + static_cast<u32>(coords[j] % 3);
+        colors[i] = color;
+        ++m_CellColorOffsets[color + 1];
+    }
+    for (u32 i = 0; i < CellColorCount<D>; ++i)
+        m_CellColorOffsets[i + 1] += m_CellColorOffsets[i];
+
+    ColorOffsetArray cursors = m_CellColorOffsets;
+    m_ColoredCells.resize(cells);
+    for (u32 i = 0; i < cells; ++i)
+        m_ColoredCells[cursors[colors[i]]++] = i;
+    Core::GetArena().Reset();
+
+    m_ColoredCellCosts.resize(cells + 1);
+    m_ColoredCellCosts[0] = 0;
+    for (u32 i = 0; i < cells; ++i)
+    {
+        const u32 cell = m_ColoredCells[i];
+        m_ColoredCellCosts[i + 1] = m_ColoredCellCosts[i] + m_CellCosts[cell + 1] - m_CellCosts[cell];
+    }
+}
+
+// Cells with a half-shell know their neighbors, so their cost is the amount of candidate pairs they visit. Other cells
+// do not, and their own population stands in for that of their neighborhood
+template <Dimension D> void LookupMethod<D>::buildCellCosts() noexcept
+{
+    const u32 cells = Grid.Cells.size();
+    m_CellCosts.resize(cells + 1);
+    m_CellCosts[0] = 0;
+    for (u32 i = 0; i < cells; ++i)
     {
-        TKit::Array<ivec<D>, 16> uniquePositions;
-        u32 uniqueSize = 0;
+        const u64 size = Grid.Cells[i].End - Grid.Cells[i].Start;
+        u64 cost = size * size;
+        if (m_HasHalfShell)
+        {
+            cost /= 2;
+            const u32 *neighbors = Grid.CellNeighbors.data() + i * s_HalfShellCount;
+            for (u32 n = 0; n < s_HalfShellCount; ++n)
+                if (neighbors[n] != UINT32_MAX)
+                    cost += size * (Grid.Cells[neighbors[n]].End - Grid.Cells[neighbors[n]].Start);
+        }
+        m_CellCosts[i + 1] = m_CellCosts[i] + cost;
+    }
+    UpdateParticleCosts();
+}
+
+// A particle-wise query costs about as much as the population of the cell it starts from
+template <Dimension D> void LookupMethod<D>::UpdateParticleCosts() noexcept
+{
+    m_ParticleCosts.resize(Grid.ParticleIndices.size() + 1);
+    m_ParticleCosts[0] = 0;
+    for (const GridCell &cell : Grid.Cells)
         for (u32 i = cell.Start; i < cell.End; ++i)
+            m_ParticleCosts[Grid.ParticleIndices[i] + 1] = cell.End - cell.Start;
+    for (u32 i = 1; i < m_ParticleCosts.size(); ++i)
+        m_ParticleCosts[i] += m_ParticleCosts[i - 1];
+}
+template <Dimension D> const u64 *LookupMethod<D>::GetParticleCosts() const noexcept
+{
+    return m_ParticleCosts.data();
+}
+
+// Every neighbor of a particle lies in the neighborhood of its cell, so lists are traversed cell by cell following
+// the coloring of the grid they were built from. The cost of a cell is the total length of its rows
+template <Dimension D> void LookupMethod<D>::buildNeighborListColors() noexcept
+{
+    Verlet.Colored = IsDense();
+    if (!Verlet.Colored)
+        return;
+
+    const u32 cells = m_ColoredCells.size();
+    Verlet.ColoredCosts.resize(cells + 1);
+    Verlet.ColoredCosts[0] = 0;
+    for (u32 i = 0; i < cells; ++i)
+    {
+        const GridCell &cell = Grid.Cells[m_ColoredCells[i]];
+        u32 cost = 0;
+        for (u32 j = cell.Start; j < cell.End; ++j)
         {
-            const u32 index = Grid.ParticleIndices[i];
-            const ivec<D> cellPosition = GetCellPosition(positions[index]);
-            if (isUnique(uniquePositions.begin(), uniquePositions.begin() + uniqueSize, cellPosition))
-                uniquePositions[uniqueSize++] = cellPosition;
+            const u32 index = Grid.ParticleIndices[j];
+            cost += Verlet.Offsets[index + 1] - Verlet.Offsets[index];
         }
+        Verlet.ColoredCosts[i + 1] = Verlet.ColoredCosts[i] + cost;
+    }
+}
 
-        const Onyx::Color color = uniqueSize == 1 ? Onyx::Color::WHITE : Onyx::Color::RED;
-        Visualization<D>::DrawCell(p_Context, uniquePositions[0], Radius, color, 0.04f);
-        cellClashes += uniqueSize - 1;
+template <Dimension D>
+void LookupMethod<D>::UpdateNeighborLists(const f32 p_Radius, const f32 p_Skin, const bool p_MultiThread) noexcept
+{
+    TKIT_PROFILE_NSCOPE("Driz::LookupMethod::UpdateNeighborLists");
+    const TKit::Clock clock{};
+    const u32 particles = m_Positions->size();
+    const auto forEach = [p_MultiThread, particles](auto &&p_Function) {
+        if (p_MultiThread)
+            Core::ForEach(0, particles, p_Function);
+        else
+            p_Function(0, particles, 0);
+    };
 
-        for (u32 i = 1; i < uniqueSize; ++i)
+    // The grid queries below use the extended cutoff
+    Radius = p_Radius + p_Skin;
+    Verlet.Offsets.resize(particles + 1);
+    Verlet.Offsets[0] = 0;
+    forEach([this](const u32 p_Start, const u32 p_End, const u32) {
+        for (u32 i = p_Start; i < p_End; ++i)
         {
-            Visualization<D>::DrawCell(p_Context, uniquePositions[i], Radius, color, 0.04f);
-            const fvec<D> pos1 = fvec<D>{uniquePositions[i - 1]} + 0.5f * Radius;
-            const fvec<D> pos2 = fvec<D>{uniquePositions[i]} + 0.5f * Radius;
+            u32 count = 0;
+            ForEachParticleGrid(i, [&count](const u32, const f32) { ++count; });
+            Verlet.Offsets[i + 1] = count;
+        }
+    });
+    for (u32 i = 0; i < particles; ++i)
+        Verlet.Offsets[i + 1] += Verlet.Offsets[i];
 
-            p_Context->Fill(Onyx::Color::YELLOW);
-            p_Context->Line(pos1, pos2, 0.08f);
+    Verlet.Neighbors.resize(Verlet.Offsets[particles]);
+    forEach([this](const u32 p_Start, const u32 p_End, const u32) {
+        for (u32 i = p_Start; i < p_End; ++i)
+        {
+            u32 *row = Verlet.Neighbors.data() + Verlet.Offsets[i];
+            u32 slot = 0;
+            ForEachParticleGrid(i, [row, &slot](const u32 p_Index, const f32) { row[slot++] = p_Index; });
+            std::sort(row, row + slot);
         }
+    });
+
+    buildNeighborListColors();
+    Verlet.ReferencePositions.assign(m_Positions->begin(), m_Positions->end());
+    Verlet.Radius = p_Radius;
+    Verlet.Skin = p_Skin;
+    Radius = p_Radius;
+    m_Timings.NeighborLists += clock.GetElapsed();
+}
+
+template <Dimension D>
+bool LookupMethod<D>::AreNeighborListsValid(const f32 p_Radius, const f32 p_Skin,
+                                            const bool p_MultiThread) const noexcept
+{
+    TKIT_PROFILE_NSCOPE("Driz::LookupMethod::CheckNeighborLists");
+    const auto &positions = *m_Positions;
+    const auto &references = Verlet.ReferencePositions;
+    if (references.size() != positions.size() || Verlet.Radius != p_Radius || Verlet.Skin != p_Skin)
+        return false;
+
+    TKit::Array<f32, TKIT_THREAD_POOL_MAX_THREADS> displacements;
+    displacements.fill(0.f);
+    const auto computeDisplacement = [&positions, &references, &displacements](const u32 p_Start, const u32 p_End,
+                                                                               const u32 p_ThreadIndex) {
+        f32 displacement = 0.f;
+        for (u32 i = p_Start; i < p_End; ++i)
+            displacement = glm::max(displacement, glm::distance2(positions[i], references[i]));
+        displacements[p_ThreadIndex] = displacement;
+    };
+    if (p_MultiThread)
+        Core::ForEach(0, positions.size(), computeDisplacement);
+    else
+        computeDisplacement(0, positions.size(), 0);
+
+    f32 maxDisplacement = 0.f;
+    for (const f32 displacement : displacements)
+        maxDisplacement = glm::max(maxDisplacement, displacement);
+
+    // Two particles may approach each other by twice the maximum displacement
+    const f32 halfSkin = 0.5f * p_Skin;
+    return maxDisplacement <= halfSkin * halfSkin;
+}
+
+template <Dimension D> void LookupMethod<D>::InvalidateNeighborLists() noexcept
+{
+    Verlet.ReferencePositions.clear();
+}
+
+template <Dimension D> void LookupMethod<D>::BeginPairCache(const bool p_MultiThread) noexcept
+{
+    m_PairCacheSegments = p_MultiThread ? Core::GetThreadCount() : 1;
+    for (u32 i = 0; i < m_PairCacheSegments; ++i)
+    {
+        // Capacity is kept across steps, so recording does not allocate once it has warmed up
+        PairCacheSegment<D> &segment = m_PairCache[i];
+        segment.Indices1.clear();
+        segment.Indices2.clear();
+        segment.SquaredDistances.clear();
+        segment.Offsets.clear();
+        segment.ColorEnds.fill(0);
     }
-    return cellClashes;
+    m_PairCacheValid = true;
+}
+// Threads may get no work for some colors, so every later color is assumed to end here until told otherwise
+template <Dimension D> void LookupMethod<D>::EndPairCacheColor(const u32 p_Color, const u32 p_ThreadIndex) noexcept
+{
+    PairCacheSegment<D> &segment = m_PairCache[p_ThreadIndex];
+    const u32 size = segment.Indices1.size();
+    for (u32 i = p_Color; i < CellColorCount<D>; ++i)
+        segment.ColorEnds[i] = size;
+}
+template <Dimension D> void LookupMethod<D>::InvalidatePairCache() noexcept
+{
+    m_PairCacheValid = false;
+}
+template <Dimension D> bool LookupMethod<D>::HasPairCache() const noexcept
+{
+    return m_PairCacheValid;
+}
+template <Dimension D> u32 LookupMethod<D>::GetCachedPairCount() const noexcept
+{
+    if (!m_PairCacheValid)
+        return 0;
+    u32 pairs = 0;
+    for (u32 i = 0; i < m_PairCacheSegments; ++i)
+        pairs += m_PairCache[i].Indices1.size();
+    return pairs;
+}
+
+template <Dimension D> const LookupTimings &LookupMethod<D>::GetTimings() const noexcept
+{
+    return m_Timings;
+}
+template <Dimension D> void LookupMethod<D>::ResetTimings() noexcept
+{
+    m_Timings = LookupTimings{};
+}
+
+template <Dimension D> u32 LookupMethod<D>::CountCellClashes() const noexcept
+{
+    TKIT_PROFILE_NSCOPE("Driz::LookupMethod::CountCellClashes");
+    if (IsDense() || !m_SoAGridOrdered)
+        return 0;
+
+    // Grid positions are the ones the cells were built from, slot for slot
+    u32 clashes = 0;
+    for (const GridCell &cell : Grid.Cells)
+    {
+        if (cell.Start == cell.End)
+            continue;
+        const ivec<D> first = GetCellPosition(m_SoAPositions.Get(cell.Start));
+        for (u32 i = cell.Start + 1; i < cell.End; ++i)
+            if (GetCellPosition(m_SoAPositions.Get(i)) != first)
+                ++clashes;
+    }
+    return clashes;
+}
+
+template <Dimension D> const SimArray<fvec<D>> &LookupMethod<D>::GetPositions() const noexcept
+{
+    return *m_Positions;
+}
+template <Dimension D> f32 LookupMethod<D>::GetCellSize() const noexcept
+{
+    return m_CellSize;
 }
 
 template <Dimension D> ivec<D> LookupMethod<D>::GetCellPosition(const fvec<D> &p_Position, const f32 p_Radius) noexcept
@@ -134,11 +596,25 @@ u32 LookupMethod<D>::GetCellKey(const ivec<D> &p_CellPosition, const u32 p_Parti
 
 template <Dimension D> ivec<D> LookupMethod<D>::GetCellPosition(const fvec<D> &p_Position) const noexcept
 {
-    return GetCellPosition(p_Position, Radius);
+    return GetCellPosition(p_Position, m_CellSize);
 }
 template <Dimension D> u32 LookupMethod<D>::GetCellKey(const ivec<D> &p_CellPosition) const noexcept
 {
-    return GetCellKey(p_CellPosition, m_Positions->size());
+    if (m_DenseCellCount == 0)
+        return GetCellKey(p_CellPosition, m_Positions->size());
+
+    // Keys are only unique inside the box. Cells outside of it are clamped to its boundary and share the key of the
+    // boundary cell they land on, so their particles become extra candidates that the distance check discards.
+    // Clamping never pulls neighboring cells more than one cell apart, so no neighbor is lost
+    u32 key = 0;
+    u32 stride = 1;
+    for (u32 i = 0; i < D; ++i)
+    {
+        const i32 coord = glm::clamp(p_CellPosition[i] - m_MinCell[i], 0, m_CellDimensions[i] - 1);
+        key += static_cast<u32>(coord) * stride;
+        stride *= static_cast<u32>(m_CellDimensions[i]);
+    }
+    return key;
 }
 
 template <Dimension D> LookupMethod<D>::OffsetArray LookupMethod<D>::getGridOffsets() const noexcept
@@ -155,10 +631,44 @@ template <Dimension D> LookupMethod<D>::OffsetArray LookupMethod<D>::getGridOffs
                 ivec<D>{1, 1, 1}};
 }
 
+template <Dimension D> LookupMethod<D>::HalfShellArray LookupMethod<D>::getHalfShellOffsets() noexcept
+{
+    if constexpr (D == D2)
+        return {ivec<D>{1, 0}, ivec<D>{-1, 1}, ivec<D>{0, 1}, ivec<D>{1, 1}};
+    else
+        return {ivec<D>{1, 0, 0},   ivec<D>{-1, 1, 0}, ivec<D>{0, 1, 0},  ivec<D>{1, 1, 0},  ivec<D>{-1, -1, 1},
+                ivec<D>{0, -1, 1},  ivec<D>{1, -1, 1}, ivec<D>{-1, 0, 1}, ivec<D>{0, 0, 1},  ivec<D>{1, 0, 1},
+                ivec<D>{-1, 1, 1},  ivec<D>{0, 1, 1},  ivec<D>{1, 1, 1}};
+}
+
 template <Dimension D> u32 LookupMethod<D>::GetCellCount() const noexcept
 {
     return Grid.Cells.size();
 }
+template <Dimension D> bool LookupMethod<D>::IsDense() const noexcept
+{
+    return m_DenseCellCount != 0;
+}
+template <Dimension D> bool LookupMethod<D>::HasGridColoring() const noexcept
+{
+    return m_HasHalfShell;
+}
+template <Dimension D> bool LookupMethod<D>::HasNeighborListColoring() const noexcept
+{
+    return Verlet.Colored;
+}
+
+// Dense keys are row-major cell coordinates relative to the minimum cell
+template <Dimension D> ivec<D> LookupMethod<D>::getDenseCellCoordinates(u32 p_CellKey) const noexcept
+{
+    ivec<D> coords;
+    for (u32 i = 0; i < D; ++i)
+    {
+        coords[i] = static_cast<i32>(p_CellKey % static_cast<u32>(m_CellDimensions[i]));
+        p_CellKey /= static_cast<u32>(m_CellDimensions[i]);
+    }
+    return coords;
+}
 
 template class LookupMethod<D2>;
 template class LookupMethod<D3>;
@@ -2,12 +2,15 @@
 
 #include "driz/core/glm.hpp"
 #include "driz/core/core.hpp"
-#include "onyx/rendering/render_context.hpp"
+#include "driz/core/soa_array.hpp"
 #include "tkit/utils/literals.hpp"
 #include <array>
 
 namespace Driz
 {
+// Cells are colored by their coordinates modulo 3 along every axis
+template <Dimension D> constexpr u32 CellColorCount = D == D2 ? 9 : 27;
+
 struct GridCell
 {
     u32 Key;
@@ -19,16 +22,101 @@ struct GridData
 {
     SimArray<GridCell> Cells;
     SimArray<u32> ParticleIndices;
-    SimArray<u32> CellKeyToIndex;
+    // Indexed by cell key. Dense grids may address more cells than there are particles
+    TKit::DynamicArray<u32> CellKeyToIndex;
+    // Half-shell neighbors of each cell, a fixed amount per cell with UINT32_MAX marking empty ones. Dense grids only
+    TKit::DynamicArray<u32> CellNeighbors;
+
+    GridData Clone() const noexcept
+    {
+        GridData grid;
+        grid.Cells = Cells.Clone();
+        grid.ParticleIndices = ParticleIndices.Clone();
+        grid.CellKeyToIndex = CellKeyToIndex;
+        grid.CellNeighbors = CellNeighbors;
+        return grid;
+    }
+};
+
+// Compressed (CSR) per-particle neighbor lists, built with a cutoff of Radius + Skin. Rows are sorted
+template <Dimension D> struct NeighborList
+{
+    TKit::DynamicArray<u32> Offsets;
+    TKit::DynamicArray<u32> Neighbors;
+    SimArray<fvec<D>> ReferencePositions;
+
+    // Prefix sum of the row lengths of the particles of each cell of the grid the lists were built from, in colored
+    // cell order. Only available when built from a dense grid, whose cells and coloring stay untouched until the next
+    // build
+    TKit::DynamicArray<u32> ColoredCosts;
+    bool Colored = false;
+
+    f32 Radius = 0.f;
+    f32 Skin = 0.f;
+};
+
+// Pairs found during a pair-wise pass, one segment per thread so that they can be recorded without synchronization
+template <Dimension D> struct PairCacheSegment
+{
+    TKit::DynamicArray<u32> Indices1;
+    TKit::DynamicArray<u32> Indices2;
+    TKit::DynamicArray<f32> SquaredDistances;
+    // Position of the first particle relative to the second, left unnormalized
+    TKit::DynamicArray<fvec<D>> Offsets;
+    // End of each color, when recorded from a colored traversal
+    TKit::Array<u32, CellColorCount<D>> ColorEnds{};
+};
+
+// Wall time spent in the parts of the lookup updates since the last ResetTimings()
+struct LookupTimings
+{
+    // Radix sort of the cell keys
+    TKit::Timespan Sort{};
+    // Merge of the particles appended since the last build into the previous order, which replaces the sort
+    TKit::Timespan Merge{};
+    // The rest of the grid updates: cell keys, cell emission, position gathering, cell neighbors, costs and colors
+    TKit::Timespan Build{};
+    TKit::Timespan NeighborLists{};
 };
 
 template <Dimension D> class LookupMethod
 {
   public:
+    // Keeps the grid order usable as the seed of the next build after particles were removed. p_NewIndices maps every
+    // previous particle index below p_Count to its new one, or to UINT32_MAX if the particle is gone. Indices past
+    // p_Count belong to an older particle set and are dropped. Cells stay stale until then
+    void RemapParticles(const u32 *p_NewIndices, u32 p_Count) noexcept;
     void SetPositions(const SimArray<fvec<D>> *p_Positions) noexcept;
 
-    void UpdateBruteForceLookup(f32 p_Radius) noexcept;
-    void UpdateGridLookup(f32 p_Radius) noexcept;
+    void UpdateBruteForceLookup(f32 p_Radius, bool p_MultiThread = false) noexcept;
+    void UpdateGridLookup(f32 p_Radius, bool p_MultiThread = false) noexcept;
+    // The half-shell neighbors of every dense cell are only needed by pair passes over the grid. Grids that only serve
+    // to build neighbor lists can skip them with p_HalfShell, and are then traversed as hashed ones would be
+    void UpdateDenseGridLookup(f32 p_Radius, const fvec<D> &p_Min, const fvec<D> &p_Max, bool p_MultiThread = false,
+                               bool p_HalfShell = true) noexcept;
+
+    // Neighbor lists are built from the current grid, which must have been built with p_Radius + p_Skin
+    void UpdateNeighborLists(f32 p_Radius, f32 p_Skin, bool p_MultiThread = false) noexcept;
+    bool AreNeighborListsValid(f32 p_Radius, f32 p_Skin, bool p_MultiThread = false) const noexcept;
+    void InvalidateNeighborLists() noexcept;
+
+    // The cache is only valid as long as positions stay untouched, which the caller must ensure
+    void BeginPairCache(bool p_MultiThread = false) noexcept;
+    void InvalidatePairCache() noexcept;
+    bool HasPairCache() const noexcept;
+    // Marks the end of p_Color in the segment of p_ThreadIndex, so that the cache can later be consumed by color
+    void EndPairCacheColor(u32 p_Color, u32 p_ThreadIndex) noexcept;
+
+    void CachePair(const u32 p_Index1, const u32 p_Index2, const f32 p_Distance2,
+                   const u32 p_ThreadIndex = 0) noexcept
+    {
+        const auto &positions = *m_Positions;
+        PairCacheSegment<D> &segment = m_PairCache[p_ThreadIndex];
+        segment.Indices1.push_back(p_Index1);
+        segment.Indices2.push_back(p_Index2);
+        segment.SquaredDistances.push_back(p_Distance2);
+        segment.Offsets.push_back(positions[p_Index1] - positions[p_Index2]);
+    }
 
     static ivec<D> GetCellPosition(const fvec<D> &p_Position, f32 p_Radius) noexcept;
     static u32 GetCellKey(const ivec<D> &p_CellPosition, u32 p_ParticleCount) noexcept;
@@ -36,21 +124,43 @@ template <Dimension D> class LookupMethod
     ivec<D> GetCellPosition(const fvec<D> &p_Position) const noexcept;
     u32 GetCellKey(const ivec<D> &p_CellPosition) const noexcept;
 
-    u32 DrawCells(Onyx::RenderContext<D> *p_Context) const noexcept;
+    const SimArray<fvec<D>> &GetPositions() const noexcept;
+    f32 GetCellSize() const noexcept;
     u32 GetCellCount() const noexcept;
+    bool IsDense() const noexcept;
 
+    bool HasGridColoring() const noexcept;
+    bool HasNeighborListColoring() const noexcept;
+
+    // Prefix sum of the estimated work of each particle in a particle-wise grid pass, indexed by particle. Must be
+    // refreshed whenever Grid.ParticleIndices is modified outside of a grid update
+    const u64 *GetParticleCosts() const noexcept;
+    void UpdateParticleCosts() noexcept;
+
+    const LookupTimings &GetTimings() const noexcept;
+    void ResetTimings() noexcept;
+
+    // Pairs recorded since the last BeginPairCache(), or zero if the cache is not valid
+    u32 GetCachedPairCount() const noexcept;
+    // Particles of a hashed grid cell that lie in a different cell of space than the first one found in it, summed
+    // over every cell. Dense grids are not counted, as they only clash outside the box, where cells are clamped onto
+    // its boundary. Reads the positions the grid was last built with, so it is only accurate until particles are
+    // removed
+    u32 CountCellClashes() const noexcept;
+
+    // All traversals hand the squared distance to their callbacks. Taking the square root is left to the consumers
+    // that actually need it
     template <typename F> void ForEachPairBruteForceST(F &&p_Function) const noexcept
     {
         const f32 r2 = Radius * Radius;
-        for (u32 i = 0; i < m_Positions->size(); ++i)
+        for (u32 i = 0; i < m_SoAPositions.size(); ++i)
             processPairWisePass(i, r2, std::forward<F>(p_Function));
     }
 
     template <typename F> void ForEachPairBruteForceMT(F &&p_Function) const noexcept
     {
-        const auto &positions = *m_Positions;
         const f32 r2 = Radius * Radius;
-        Core::ForEach(0, positions.size(),
+        Core::ForEach(0, m_SoAPositions.size(),
                       [this, r2, &p_Function](const u32 p_Start, const u32 p_End, const u32 p_ThreadIndex) {
                           for (u32 i = p_Start; i < p_End; ++i)
                               processPairWisePass(i, r2, std::forward<F>(p_Function), p_ThreadIndex);
@@ -59,6 +169,12 @@ template <Dimension D> class LookupMethod
 
     template <typename F> void ForEachPairGridST(F &&p_Function) const noexcept
     {
+        if (m_HasHalfShell)
+        {
+            for (u32 i = 0; i < Grid.Cells.size(); ++i)
+                processHalfShellCell(i, std::forward<F>(p_Function));
+            return;
+        }
         const OffsetArray offsets = getGridOffsets();
         for (const GridCell &cell : Grid.Cells)
             processPairWiseCell(cell, offsets, std::forward<F>(p_Function));
@@ -66,12 +182,106 @@ template <Dimension D> class LookupMethod
 
     template <typename F> void ForEachPairGridMT(F &&p_Function) const noexcept
     {
+        if (m_HasHalfShell)
+        {
+            Core::ForEachWeighted(0, Grid.Cells.size(), m_CellCosts.data(),
+                                  [this, &p_Function](const u32 p_Start, const u32 p_End, const u32 p_ThreadIndex) {
+                                      for (u32 i = p_Start; i < p_End; ++i)
+                                          processHalfShellCell(i, std::forward<F>(p_Function), p_ThreadIndex);
+                                  });
+            return;
+        }
         const OffsetArray offsets = getGridOffsets();
-        Core::ForEach(0, Grid.Cells.size(),
-                      [this, &offsets, &p_Function](const u32 p_Start, const u32 p_End, const u32 p_ThreadIndex) {
-                          for (u32 i = p_Start; i < p_End; ++i)
-                              processPairWiseCell(Grid.Cells[i], offsets, std::forward<F>(p_Function), p_ThreadIndex);
-                      });
+        Core::ForEachWeighted(
+            0, Grid.Cells.size(), m_CellCosts.data(),
+            [this, &offsets, &p_Function](const u32 p_Start, const u32 p_End, const u32 p_ThreadIndex) {
+                for (u32 i = p_Start; i < p_End; ++i)
+                    processPairWiseCell(Grid.Cells[i], offsets, std::forward<F>(p_Function), p_ThreadIndex);
+            });
+    }
+
+    template <typename F> void ForEachPairVerletST(F &&p_Function) const noexcept
+    {
+        const f32 r2 = Radius * Radius;
+        for (u32 i = 0; i < m_Positions->size(); ++i)
+            processVerletPairs(i, r2, std::forward<F>(p_Function));
+    }
+
+    template <typename F> void ForEachPairVerletMT(F &&p_Function) const noexcept
+    {
+        const f32 r2 = Radius * Radius;
+        Core::ForEachWeighted(0, m_Positions->size(), Verlet.Offsets.data(),
+                              [this, r2, &p_Function](const u32 p_Start, const u32 p_End, const u32 p_ThreadIndex) {
+                                  for (u32 i = p_Start; i < p_End; ++i)
+                                      processVerletPairs(i, r2, std::forward<F>(p_Function), p_ThreadIndex);
+                              });
+    }
+
+    // Colored traversals never hand pairs sharing a particle to two threads at once, so both particles of a pair may be
+    // written to without synchronization or private copies. Cells of the same color are at least three cells apart, so
+    // their neighborhoods do not overlap, and colors are processed one after the other. p_Flush(color, threadIndex) is
+    // called once a thread is done with its share of a color: pairs must not be held past that point
+    template <typename F, typename G> void ForEachPairGridColoredMT(F &&p_Function, G &&p_Flush) const noexcept
+    {
+        forEachColor(
+            m_ColoredCells, m_CellColorOffsets, m_ColoredCellCosts.data(),
+            [this, &p_Function](const u32 p_CellIndex, const u32 p_ThreadIndex) {
+                processHalfShellCell(p_CellIndex, std::forward<F>(p_Function), p_ThreadIndex);
+            },
+            std::forward<G>(p_Flush));
+    }
+
+    // Work is split by build-time cell, never by particle: particles of a same cell share neighbors, so they must all
+    // be processed by the same thread
+    template <typename F, typename G> void ForEachPairVerletColoredMT(F &&p_Function, G &&p_Flush) const noexcept
+    {
+        const f32 r2 = Radius * Radius;
+        forEachColor(
+            m_ColoredCells, m_CellColorOffsets, Verlet.ColoredCosts.data(),
+            [this, r2, &p_Function](const u32 p_CellIndex, const u32 p_ThreadIndex) {
+                const GridCell &cell = Grid.Cells[p_CellIndex];
+                for (u32 i = cell.Start; i < cell.End; ++i)
+                    processVerletPairs(Grid.ParticleIndices[i], r2, std::forward<F>(p_Function), p_ThreadIndex);
+            },
+            std::forward<G>(p_Flush));
+    }
+
+    // Segments are handed whole so that kernels can be evaluated over their distances in bulk
+    template <typename F> void ForEachCachedSegmentST(F &&p_Function) const noexcept
+    {
+        for (u32 i = 0; i < m_PairCacheSegments; ++i)
+            std::forward<F>(p_Function)(m_PairCache[i]);
+    }
+
+    // Replays a cache recorded by a colored traversal with the same guarantees. Every cell is recorded whole into a
+    // single segment, so segments of the same color never share a particle. p_Function receives a segment and the
+    // range of it belonging to the current color
+    template <typename F> void ForEachCachedSegmentColoredMT(F &&p_Function) const noexcept
+    {
+        for (u32 color = 0; color < CellColorCount<D>; ++color)
+            Core::ForEach(0, m_PairCacheSegments,
+                          [this, color, &p_Function](const u32 p_Start, const u32 p_End, const u32 p_ThreadIndex) {
+                              for (u32 i = p_Start; i < p_End; ++i)
+                              {
+                                  const PairCacheSegment<D> &segment = m_PairCache[i];
+                                  const u32 begin = color == 0 ? 0 : segment.ColorEnds[color - 1];
+                                  std::forward<F>(p_Function)(segment, begin, segment.ColorEnds[color],
+                                                              p_ThreadIndex);
+                              }
+                          });
+    }
+
+    template <typename F> void ForEachParticleVerlet(const u32 p_Index, F &&p_Function) const noexcept
+    {
+        const auto &positions = *m_Positions;
+        const f32 r2 = Radius * Radius;
+        for (u32 i = Verlet.Offsets[p_Index]; i < Verlet.Offsets[p_Index + 1]; ++i)
+        {
+            const u32 index = Verlet.Neighbors[i];
+            const f32 distance = glm::distance2(positions[p_Index], positions[index]);
+            if (distance < r2)
+                std::forward<F>(p_Function)(index, distance);
+        }
     }
 
     template <typename F> void ForEachParticleBruteForce(const u32 p_Index, F &&p_Function) const noexcept
@@ -83,7 +293,7 @@ template <Dimension D> class LookupMethod
             {
                 const f32 distance = glm::distance2(positions[p_Index], positions[i]);
                 if (distance < r2)
-                    std::forward<F>(p_Function)(i, glm::sqrt(distance));
+                    std::forward<F>(p_Function)(i, distance);
             }
     }
 
@@ -96,7 +306,7 @@ template <Dimension D> class LookupMethod
         const auto processPair = [r2, p_Index1, &positions](const u32 p_Index2, F &&p_Function) {
             const f32 distance = glm::distance2(positions[p_Index1], positions[p_Index2]);
             if (distance < r2)
-                std::forward<F>(p_Function)(p_Index2, glm::sqrt(distance));
+                std::forward<F>(p_Function)(p_Index2, distance);
         };
 
         const ivec<D> center = GetCellPosition(positions[p_Index1]);
@@ -135,21 +345,118 @@ template <Dimension D> class LookupMethod
     }
 
     GridData Grid;
+    NeighborList<D> Verlet;
     f32 Radius;
 
   private:
     static constexpr u32 s_OffsetCount = D * D * D + 2 - D;
     using OffsetArray = TKit::Array<ivec<D>, s_OffsetCount>;
 
+    // Half of the neighboring cells, chosen so that every pair of adjacent cells is visited exactly once
+    static constexpr u32 s_HalfShellCount = s_OffsetCount / 2;
+    static constexpr u32 s_DistanceBatch = 64;
+    using HalfShellArray = TKit::Array<ivec<D>, s_HalfShellCount>;
+    using ColorOffsetArray = TKit::Array<u32, CellColorCount<D> + 1>;
+
+    // Pairs are flushed after every claimed chunk, as a thread cannot know whether it will get another one
+    template <typename T, typename F, typename G>
+    void forEachColor(const TKit::DynamicArray<u32> &p_Items, const ColorOffsetArray &p_Offsets,
+                      const T *p_CostPrefix, F &&p_Function, G &&p_Flush) const noexcept
+    {
+        for (u32 color = 0; color < CellColorCount<D>; ++color)
+            Core::ForEachWeighted(p_Offsets[color], p_Offsets[color + 1], p_CostPrefix,
+                                  [color, &p_Items, &p_Function, &p_Flush](const u32 p_Start, const u32 p_End,
+                                                                          const u32 p_ThreadIndex) {
+                                      for (u32 i = p_Start; i < p_End; ++i)
+                                          p_Function(p_Items[i], p_ThreadIndex);
+                                      p_Flush(color, p_ThreadIndex);
+                                  });
+    }
+
     template <typename F, typename... Args>
     void processPairWisePass(const u32 p_Index, const f32 p_Radius2, F &&p_Function, Args &&...p_Args) const noexcept
+    {
+        const u32 *indices = m_SoAGridOrdered ? Grid.ParticleIndices.data() : nullptr;
+        processSlotRange(p_Index, p_Index + 1, m_SoAPositions.size(), p_Radius2, indices, std::forward<F>(p_Function),
+                         std::forward<Args>(p_Args)...);
+    }
+
+    // Squared distances from p_Position to the SoA slots [p_Start, p_End). Kept branch-free so that it vectorizes
+    void computeDistances2(const fvec<D> &p_Position, const u32 p_Start, const u32 p_End,
+                           f32 *p_Distances) const noexcept
+    {
+        const u32 size = p_End - p_Start;
+        for (u32 j = 0; j < size; ++j)
+            p_Distances[j] = 0.f;
+        for (u32 i = 0; i < D; ++i)
+        {
+            const f32 *stream = m_SoAPositions.GetStream(i) + p_Start;
+            const f32 coord = p_Position[i];
+            for (u32 j = 0; j < size; ++j)
+            {
+                const f32 diff = stream[j] - coord;
+                p_Distances[j] += diff * diff;
+            }
+        }
+    }
+
+    // Calls p_Function for every slot in [p_Start, p_End) within the radius of p_Slot. Slots are translated to
+    // particle indices through p_Indices, or used as is if it is null
+    template <typename F, typename... Args>
+    void processSlotRange(const u32 p_Slot, const u32 p_Start, const u32 p_End, const f32 p_Radius2,
+                          const u32 *p_Indices, F &&p_Function, Args &&...p_Args) const noexcept
+    {
+        const fvec<D> position = m_SoAPositions.Get(p_Slot);
+        const u32 index1 = p_Indices ? p_Indices[p_Slot] : p_Slot;
+
+        TKit::Array<f32, s_DistanceBatch> distances;
+        for (u32 start = p_Start; start < p_End; start += s_DistanceBatch)
+        {
+            const u32 end = glm::min(start + s_DistanceBatch, p_End);
+            computeDistances2(position, start, end, distances.data());
+            for (u32 j = start; j < end; ++j)
+                if (distances[j - start] < p_Radius2)
+                    std::forward<F>(p_Function)(index1, p_Indices ? p_Indices[j] : j, distances[j - start],
+                                                std::forward<Args>(p_Args)...);
+        }
+    }
+
+    template <typename F, typename... Args>
+    void processVerletPairs(const u32 p_Index, const f32 p_Radius2, F &&p_Function, Args &&...p_Args) const noexcept
     {
         const auto &positions = *m_Positions;
-        for (u32 j = p_Index + 1; j < positions.size(); ++j)
+        const u32 *begin = Verlet.Neighbors.data() + Verlet.Offsets[p_Index];
+        const u32 *end = Verlet.Neighbors.data() + Verlet.Offsets[p_Index + 1];
+
+        // Rows are sorted, so each pair is visited once, from its lowest index
+        for (const u32 *it = std::upper_bound(begin, end, p_Index); it != end; ++it)
         {
-            const f32 distance = glm::distance2(positions[p_Index], positions[j]);
+            const f32 distance = glm::distance2(positions[p_Index], positions[*it]);
             if (distance < p_Radius2)
-                std::forward<F>(p_Function)(p_Index, j, glm::sqrt(distance), std::forward<Args>(p_Args)...);
+                std::forward<F>(p_Function)(p_Index, *it, distance, std::forward<Args>(p_Args)...);
+        }
+    }
+
+    template <typename F, typename... Args>
+    void processHalfShellCell(const u32 p_CellIndex, F &&p_Function, Args &&...p_Args) const noexcept
+    {
+        const f32 r2 = Radius * Radius;
+        const u32 *indices = Grid.ParticleIndices.data();
+        const GridCell &cell1 = Grid.Cells[p_CellIndex];
+        const u32 *neighbors = Grid.CellNeighbors.data() + p_CellIndex * s_HalfShellCount;
+
+        // Particle positions are laid out in grid order, so every cell is a contiguous slot range
+        for (u32 i = cell1.Start; i < cell1.End; ++i)
+        {
+            processSlotRange(i, i + 1, cell1.End, r2, indices, std::forward<F>(p_Function),
+                             std::forward<Args>(p_Args)...);
+            for (u32 n = 0; n < s_HalfShellCount; ++n)
+                if (neighbors[n] != UINT32_MAX)
+                {
+                    const GridCell &cell2 = Grid.Cells[neighbors[n]];
+                    processSlotRange(i, cell2.Start, cell2.End, r2, indices, std::forward<F>(p_Function),
+                                     std::forward<Args>(p_Args)...);
+                }
         }
     }
 
@@ -158,23 +465,14 @@ template <Dimension D> class LookupMethod
                              Args &&...p_Args) const noexcept
     {
         const f32 r2 = Radius * Radius;
-        const auto &positions = *m_Positions;
-
-        const auto processPair = [r2, &positions](const u32 p_Index1, const u32 p_Index2, F &&p_Function,
-                                                  Args &&...p_Args) {
-            const f32 distance = glm::distance2(positions[p_Index1], positions[p_Index2]);
-            if (distance < r2)
-                std::forward<F>(p_Function)(p_Index1, p_Index2, glm::sqrt(distance), std::forward<Args>(p_Args)...);
-        };
+        const u32 *indices = Grid.ParticleIndices.data();
 
         for (u32 i = p_Cell.Start; i < p_Cell.End; ++i)
         {
-            const u32 index1 = Grid.ParticleIndices[i];
-            for (u32 j = i + 1; j < p_Cell.End; ++j)
-                processPair(index1, Grid.ParticleIndices[j], std::forward<F>(p_Function),
-                            std::forward<Args>(p_Args)...);
+            processSlotRange(i, i + 1, p_Cell.End, r2, indices, std::forward<F>(p_Function),
+                             std::forward<Args>(p_Args)...);
 
-            const ivec<D> center = GetCellPosition(positions[index1]);
+            const ivec<D> center = GetCellPosition(m_SoAPositions.Get(i));
             const u32 cellKey1 = p_Cell.Key;
 
             TKit::Array<u32, s_OffsetCount> visited;
@@ -194,16 +492,54 @@ template <Dimension D> class LookupMethod
                 if (cellKey2 > cellKey1 && cellIndex != UINT32_MAX && checkVisited(cellKey2))
                 {
                     const GridCell &cell2 = Grid.Cells[cellIndex];
-                    for (u32 j = cell2.Start; j < cell2.End; ++j)
-                        processPair(index1, Grid.ParticleIndices[j], std::forward<F>(p_Function),
-                                    std::forward<Args>(p_Args)...);
+                    processSlotRange(i, cell2.Start, cell2.End, r2, indices, std::forward<F>(p_Function),
+                                     std::forward<Args>(p_Args)...);
                 }
             }
         }
     }
 
     OffsetArray getGridOffsets() const noexcept;
+    static HalfShellArray getHalfShellOffsets() noexcept;
+    void buildGrid(u32 p_KeyCount, bool p_MultiThread) noexcept;
+    void buildCellNeighbors(bool p_MultiThread) noexcept;
+    void buildCellColors() noexcept;
+    void buildCellCosts() noexcept;
+    void buildNeighborListColors() noexcept;
+    ivec<D> getDenseCellCoordinates(u32 p_CellKey) const noexcept;
 
     const SimArray<fvec<D>> *m_Positions = nullptr;
+    // Copy of the positions used by the pair-wise passes. In grid order after a grid update, in index order otherwise.
+    // The particle state itself stays interleaved, as integration, import/export and drawing all want whole vectors.
+    // The copy costs one O(N) gather per build, fused with the grid order scatter, against the several distance
+    // checks per particle of every pair-wise pass, which it turns into contiguous, vectorizable streams. drizzle-bench
+    // reports the gather next to the build and the pair pass as 'lookup/soa-gather'
+    SoAArray<D> m_SoAPositions;
+    bool m_SoAGridOrdered = false;
+    f32 m_CellSize = 1.f;
+
+    // Dense grid addressing. A cell count of 0 means keys are hashed instead
+    ivec<D> m_MinCell{0};
+    ivec<D> m_CellDimensions{0};
+    u32 m_DenseCellCount = 0;
+    // Whether Grid.CellNeighbors holds the half-shell of every cell of the current grid
+    bool m_HasHalfShell = false;
+
+    // Dense cells grouped by color, see CellColorCount
+    TKit::DynamicArray<u32> m_ColoredCells;
+    ColorOffsetArray m_CellColorOffsets{};
+
+    // Prefix sums of estimated pair work, used to balance the multithreaded passes. Cells are in grid and colored
+    // order respectively
+    TKit::DynamicArray<u64> m_CellCosts;
+    TKit::DynamicArray<u64> m_ColoredCellCosts;
+    TKit::DynamicArray<u64> m_ParticleCosts;
+
+    // Segments in use since the last BeginPairCache(), which may be recorded by up to that many threads
+    TKit::Array<PairCacheSegment<D>, TKIT_THREAD_POOL_MAX_THREADS> m_PairCache;
+    u32 m_PairCacheSegments = 0;
+    bool m_PairCacheValid = false;
+
+    LookupTimings m_Timings{};
 };
 } // namespace Driz
\ No newline at end of file
@@ -3,8 +3,8 @@
 #include "driz/simulation/kernel.hpp"
 #include "driz/core/glm.hpp"
 #include "driz/core/core.hpp"
-#include "onyx/draw/color.hpp"
 #include "tkit/container/array.hpp"
+#include "tkit/container/static_array.hpp"
 #include "tkit/reflection/reflect.hpp"
 
 namespace Driz
@@ -15,7 +15,13 @@ enum class ParticleLookupMode
     BruteForceMultiThread,
 
     GridSingleThread,
-    GridMultiThread
+    GridMultiThread,
+
+    DenseGridSingleThread,
+    DenseGridMultiThread,
+
+    VerletListSingleThread,
+    VerletListMultiThread
 };
 
 enum class ParticleIterationMode
@@ -24,6 +30,21 @@ enum class ParticleIterationMode
     ParticleWise
 };
 
+constexpr u32 MaxFlowVolumes = 8;
+
+// An axis aligned box that either spawns particles, as an emitter, or removes every particle that enters it, as a
+// sink. Settings are shared by both dimensions, so 2D simulations ignore the third component
+struct FlowVolume
+{
+    TKIT_REFLECT_DECLARE(FlowVolume)
+    fvec3 Min{-1.f};
+    fvec3 Max{1.f};
+    // Emitters only: velocity of the spawned particles and how many are spawned per second
+    fvec3 Velocity{0.f};
+    f32 Rate = 0.f;
+    bool Enabled = true;
+};
+
 struct SimulationSettings
 {
     TKIT_REFLECT_DECLARE(SimulationSettings)
@@ -48,17 +69,46 @@ struct SimulationSettings
     f32 MouseRadius = 6.f;
     f32 MouseForce = -30.f;
 
-    ParticleLookupMode LookupMode = ParticleLookupMode::GridMultiThread;
+    // Dense grids are the default because their multithreaded pair-wise passes can be colored, see SupportsColoring
+    ParticleLookupMode LookupMode = ParticleLookupMode::DenseGridMultiThread;
     ParticleIterationMode IterationMode = ParticleIterationMode::PairWise;
 
+    // Steps between spatial reorderings of the particle arrays. 0 disables it
+    u32 ReorderInterval = 0;
+
+    // Extra distance covered by the neighbor lists, which are only rebuilt once a particle moves half of it
+    f32 VerletSkin = 0.3f;
+
+    // Record the pairs found by the density pass so that the force pass does not have to search them again
+    bool CachePairs = true;
+
+    // Fast-math mode: kernels are read from tables indexed by squared distance instead of being evaluated exactly
+    bool TabulatedKernels = false;
+
+    // Split every frame into as many steps as the fastest particle needs to stay stable. Each step may travel at most
+    // CourantNumber smoothing radii, and may take at most ForceNumber * sqrt(h / a), with a the largest acceleration
+    bool AdaptiveTimestep = false;
+    f32 CourantNumber = 0.4f;
+    f32 ForceNumber = 0.25f;
+    // Once reached, the rest of the frame is dropped and the simulation runs slower than real time
+    u32 MaxSubsteps = 16;
+
     KernelType KType = KernelType::Spiky3;
     KernelType NearKType = KernelType::Spiky5;
     TKIT_REFLECT_GROUP_END()
 
-    TKit::Array<Onyx::Color, 3> Gradient = {Onyx::Color::CYAN, Onyx::Color::YELLOW, Onyx::Color::RED};
+    // RGBA colors particles are drawn with, from resting to FastSpeed
+    TKit::Array<fvec4, 3> Gradient = {fvec4{0.f, 1.f, 1.f, 1.f}, fvec4{1.f, 1.f, 0.f, 1.f}, fvec4{1.f, 0.f, 0.f, 1.f}};
+
+    TKit::StaticArray<FlowVolume, MaxFlowVolumes> Emitters;
+    TKit::StaticArray<FlowVolume, MaxFlowVolumes> Sinks;
 
     bool UsesGrid() const noexcept;
+    bool UsesDenseGrid() const noexcept;
+    bool UsesNeighborLists() const noexcept;
     bool UsesMultiThread() const noexcept;
+    // Whether multithreaded pair-wise passes may run colored with this lookup mode. Otherwise they run particle-wise
+    bool SupportsColoring() const noexcept;
 };
 
 template <Dimension D> struct SimulationState
@@ -69,6 +119,16 @@ template <Dimension D> struct SimulationState
 
     fvec<D> Min{-30.f};
     fvec<D> Max{30.f};
+
+    SimulationState Clone() const noexcept
+    {
+        SimulationState state;
+        state.Positions = Positions.Clone();
+        state.Velocities = Velocities.Clone();
+        state.Min = Min;
+        state.Max = Max;
+        return state;
+    }
 };
 
 using Density = fvec2;
@@ -80,5 +140,19 @@ template <Dimension D> struct SimulationData
     SimArray<fvec<D>> StagedPositions;
 
     SimArray<Density> Densities; // Density and Near Density
+
+    // Particles may be reordered in memory, so this maps each slot to a stable, external identifier
+    SimArray<u32> Ids;
+
+    SimulationData Clone() const noexcept
+    {
+        SimulationData data;
+        data.State = State.Clone();
+        data.Accelerations = Accelerations.Clone();
+        data.StagedPositions = StagedPositions.Clone();
+        data.Densities = Densities.Clone();
+        data.Ids = Ids.Clone();
+        return data;
+    }
 };
 } // namespace Driz
\ No newline at end of file
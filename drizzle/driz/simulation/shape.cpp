@@ -0,0 +1,117 @@
+#include "driz/simulation/shape.hpp"
+
+namespace Driz
+{
+template <Dimension D>
+void GenerateLattice(const uvec<D> &p_Counts, const f32 p_Spacing, const fvec<D> &p_Origin,
+                     SimArray<fvec<D>> &p_Positions) noexcept
+{
+    u32 count = 1;
+    for (u32 i = 0; i < D; ++i)
+        count *= p_Counts[i];
+
+    const u32 start = p_Positions.size();
+    p_Positions.resize_uninitialized(start + count);
+    Core::ForEach(0, count, [&](const u32 p_Start, const u32 p_End, const u32) {
+        for (u32 i = p_Start; i < p_End; ++i)
+        {
+            // The last axis varies fastest, as in nested loops over the axes in order
+            fvec<D> position;
+            u32 rest = i;
+            for (u32 j = D; j-- > 0;)
+            {
+                position[j] = p_Origin[j] + static_cast<f32>(rest % p_Counts[j]) * p_Spacing;
+                rest /= p_Counts[j];
+            }
+            p_Positions[start + i] = position;
+        }
+    });
+}
+
+// Lattice points along twice p_HalfExtent. Checked before the cast, as converting a negative or NaN float to an
+// unsigned integer is undefined
+static u32 getLatticeCount(const f32 p_HalfExtent, const f32 p_Spacing) noexcept
+{
+    if (!(p_HalfExtent >= 0.f) || !(p_Spacing > 0.f))
+        return 0;
+    return static_cast<u32>(2.f * p_HalfExtent / p_Spacing) + 1;
+}
+
+// Keeps the points appended after p_Start that lie within p_Radius of p_Center
+template <Dimension D>
+static void keepWithinRadius(SimArray<fvec<D>> &p_Positions, const u32 p_Start, const fvec<D> &p_Center,
+                             const f32 p_Radius) noexcept
+{
+    u32 kept = p_Start;
+    for (u32 i = p_Start; i < p_Positions.size(); ++i)
+        if (glm::distance2(p_Positions[i], p_Center) <= p_Radius * p_Radius)
+            p_Positions[kept++] = p_Positions[i];
+    p_Positions.resize(kept);
+}
+
+template <Dimension D>
+static void generateJet(const ParticleShape<D> &p_Shape, SimArray<fvec<D>> &p_Positions) noexcept
+{
+    const f32 radius = p_Shape.Size[0];
+    const u32 count = getLatticeCount(radius, p_Shape.Spacing);
+    if (count == 0)
+        return;
+    const f32 offset = 0.5f * p_Shape.Spacing * static_cast<f32>(count - 1);
+
+    const f32 speed = glm::length(p_Shape.Velocity);
+    fvec<D> direction{0.f};
+    direction[1] = 1.f;
+    if (speed > 0.f)
+        direction = p_Shape.Velocity / speed;
+
+    if constexpr (D == D2)
+    {
+        const fvec2 across{-direction.y, direction.x};
+        for (u32 i = 0; i < count; ++i)
+            p_Positions.push_back(p_Shape.Center + (static_cast<f32>(i) * p_Shape.Spacing - offset) * across);
+    }
+    else
+    {
+        const fvec3 helper = glm::abs(direction.x) < 0.9f ? fvec3{1.f, 0.f, 0.f} : fvec3{0.f, 1.f, 0.f};
+        const fvec3 u = glm::normalize(glm::cross(direction, helper));
+        const fvec3 v = glm::cross(direction, u);
+
+        const u32 start = p_Positions.size();
+        for (u32 i = 0; i < count; ++i)
+            for (u32 j = 0; j < count; ++j)
+                p_Positions.push_back(p_Shape.Center + (static_cast<f32>(i) * p_Shape.Spacing - offset) * u +
+                                      (static_cast<f32>(j) * p_Shape.Spacing - offset) * v);
+        keepWithinRadius<D>(p_Positions, start, p_Shape.Center, radius);
+    }
+}
+
+template <Dimension D> void GenerateShape(const ParticleShape<D> &p_Shape, SimArray<fvec<D>> &p_Positions) noexcept
+{
+    if (p_Shape.Type == ShapeType::Jet)
+    {
+        generateJet<D>(p_Shape, p_Positions);
+        return;
+    }
+
+    const fvec<D> size = p_Shape.Type == ShapeType::Block ? p_Shape.Size : fvec<D>{p_Shape.Size[0]};
+    uvec<D> counts;
+    for (u32 i = 0; i < D; ++i)
+    {
+        counts[i] = getLatticeCount(size[i], p_Shape.Spacing);
+        if (counts[i] == 0)
+            return;
+    }
+
+    const u32 start = p_Positions.size();
+    const fvec<D> origin = p_Shape.Center - 0.5f * p_Shape.Spacing * fvec<D>{counts - 1u};
+    GenerateLattice<D>(counts, p_Shape.Spacing, origin, p_Positions);
+    if (p_Shape.Type == ShapeType::Sphere)
+        keepWithinRadius<D>(p_Positions, start, p_Shape.Center, size[0]);
+}
+
+template void GenerateLattice<D2>(const uvec<D2> &, f32, const fvec<D2> &, SimArray<fvec<D2>> &) noexcept;
+template void GenerateLattice<D3>(const uvec<D3> &, f32, const fvec<D3> &, SimArray<fvec<D3>> &) noexcept;
+
+template void GenerateShape<D2>(const ParticleShape<D2> &, SimArray<fvec<D2>> &) noexcept;
+template void GenerateShape<D3>(const ParticleShape<D3> &, SimArray<fvec<D3>> &) noexcept;
+} // namespace Driz
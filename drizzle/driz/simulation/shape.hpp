@@ -0,0 +1,34 @@
+#pragma once
+
+#include "driz/core/glm.hpp"
+#include "driz/core/core.hpp"
+
+namespace Driz
+{
+enum class ShapeType : u8
+{
+    Block = 0,
+    Sphere = 1,
+    Jet = 2
+};
+
+// A region filled with particles laid out on a regular lattice, Spacing apart
+template <Dimension D> struct ParticleShape
+{
+    ShapeType Type = ShapeType::Block;
+    fvec<D> Center{0.f};
+    // Half extents of a block. Spheres and jets use the first component as their radius
+    fvec<D> Size{1.f};
+    // Given to every particle. A jet is a disc (a segment in 2D) facing its velocity
+    fvec<D> Velocity{0.f};
+    f32 Spacing = 0.2f;
+};
+
+// Appends p_Counts lattice points per axis, p_Spacing apart and starting at p_Origin. Points are written in parallel
+template <Dimension D>
+void GenerateLattice(const uvec<D> &p_Counts, f32 p_Spacing, const fvec<D> &p_Origin,
+                     SimArray<fvec<D>> &p_Positions) noexcept;
+
+// Appends the positions of every particle in the shape. Negative sizes and non positive spacings generate nothing
+template <Dimension D> void GenerateShape(const ParticleShape<D> &p_Shape, SimArray<fvec<D>> &p_Positions) noexcept;
+} // namespace Driz
@@ -0,0 +1,140 @@
+#include "driz/simulation/sim_thread.hpp"
+#include "tkit/profiling/macros.hpp"
+#include <chrono>
+
+namespace Driz
+{
+template <Dimension D> SimulationThread<D>::SimulationThread(Solver<D> *p_Solver) noexcept : m_Solver(p_Solver)
+{
+}
+template <Dimension D> SimulationThread<D>::~SimulationThread() noexcept
+{
+    Stop();
+}
+
+template <Dimension D> void SimulationThread<D>::Start(const f32 p_FrameTime) noexcept
+{
+    if (IsRunning())
+        return;
+
+    m_FrameTime = p_FrameTime;
+    m_MousePressed = false;
+    m_Paused = false;
+    m_Stop.store(false, std::memory_order_relaxed);
+
+    // The first snapshot is published from here so that there is something to draw before the first frame completes
+    publishSnapshot(0.f);
+    m_Thread = std::thread([this]() { run(); });
+}
+
+template <Dimension D> void SimulationThread<D>::Stop() noexcept
+{
+    if (!IsRunning())
+        return;
+    m_Stop.store(true, std::memory_order_release);
+    m_Thread.join();
+    applyInput();
+}
+
+template <Dimension D> bool SimulationThread<D>::IsRunning() const noexcept
+{
+    return m_Thread.joinable();
+}
+
+template <Dimension D> bool SimulationThread<D>::Push(const SimulationCommand<D> &p_Command) noexcept
+{
+    return m_Commands.Push(p_Command);
+}
+
+template <Dimension D> void SimulationThread<D>::PublishSettings(const SimulationSettings &p_Settings) noexcept
+{
+    m_Settings.GetWriteBuffer() = p_Settings;
+    m_Settings.Publish();
+}
+
+template <Dimension D> const SimulationSnapshot<D> &SimulationThread<D>::AcquireSnapshot() noexcept
+{
+    m_Snapshots.Update();
+    return m_Snapshots.GetReadBuffer();
+}
+
+template <Dimension D> void SimulationThread<D>::run() noexcept
+{
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point next = Clock::now();
+    while (!m_Stop.load(std::memory_order_acquire))
+    {
+        TKIT_PROFILE_NSCOPE("Driz::SimulationThread::Frame");
+        const Clock::time_point start = Clock::now();
+        applyInput();
+        if (!m_Paused)
+        {
+            Core::ResetBusyTimes();
+            Core::BeginParallelRegion();
+            m_Solver->Advance(m_FrameTime, [this](const f32 p_DeltaTime) {
+                m_Solver->Step(p_DeltaTime, m_MousePressed ? &m_MousePosition : nullptr);
+            });
+            Core::EndParallelRegion();
+        }
+        publishSnapshot(std::chrono::duration<f32>(Clock::now() - start).count());
+
+        // A frame that took too long is not caught up on, as that would only make the following ones late as well
+        next += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<f32>(m_FrameTime));
+        const Clock::time_point now = Clock::now();
+        if (next < now)
+            next = now;
+        else
+            std::this_thread::sleep_until(next);
+    }
+}
+
+template <Dimension D> void SimulationThread<D>::applyInput() noexcept
+{
+    if (m_Settings.Update())
+        m_Solver->Settings = m_Settings.GetReadBuffer();
+
+    SimulationCommand<D> command;
+    while (m_Commands.Pop(command))
+        switch (command.Type)
+        {
+        case SimulationCommandType::AddParticle:
+            m_Solver->AddParticle(command.Position);
+            break;
+        case SimulationCommandType::AddShape:
+            m_Solver->AddParticles(command.Shape);
+            break;
+        case SimulationCommandType::SetMouse:
+            m_MousePosition = command.Position;
+            m_MousePressed = command.Enabled;
+            break;
+        case SimulationCommandType::SetBounds:
+            m_Solver->Data.State.Min = command.Position;
+            m_Solver->Data.State.Max = command.Max;
+            break;
+        case SimulationCommandType::SetFrameTime:
+            m_FrameTime = command.FrameTime;
+            break;
+        case SimulationCommandType::SetPaused:
+            m_Paused = command.Enabled;
+            break;
+        }
+}
+
+template <Dimension D> void SimulationThread<D>::publishSnapshot(const f32 p_StepTime) noexcept
+{
+    // The buffers keep their capacity, so once the particle count settles this is a plain copy
+    SimulationSnapshot<D> &snapshot = m_Snapshots.GetWriteBuffer();
+    const SimulationState<D> &state = m_Solver->Data.State;
+    snapshot.State.Positions.assign(state.Positions.begin(), state.Positions.end());
+    snapshot.State.Velocities.assign(state.Velocities.begin(), state.Velocities.end());
+    snapshot.State.Min = state.Min;
+    snapshot.State.Max = state.Max;
+    snapshot.Stats = m_Solver->GetTimestepStats();
+    snapshot.StepTime = p_StepTime;
+    snapshot.Frames = m_Frames++;
+    m_Snapshots.Publish();
+}
+
+template class SimulationThread<D2>;
+template class SimulationThread<D3>;
+} // namespace Driz
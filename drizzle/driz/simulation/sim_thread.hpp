@@ -0,0 +1,91 @@
+#pragma once
+
+#include "driz/simulation/solver.hpp"
+#include "driz/core/triple_buffer.hpp"
+#include "driz/core/spsc_queue.hpp"
+#include <thread>
+
+namespace Driz
+{
+enum class SimulationCommandType : u8
+{
+    AddParticle = 0,
+    AddShape,
+    SetMouse,
+    SetBounds,
+    SetFrameTime,
+    SetPaused
+};
+
+// Input for the simulation thread. Only the fields relevant to the command type are read
+template <Dimension D> struct SimulationCommand
+{
+    SimulationCommandType Type;
+    // Particle to add, mouse position or lower bound of the bounding box
+    fvec<D> Position{0.f};
+    // Upper bound of the bounding box
+    fvec<D> Max{0.f};
+    ParticleShape<D> Shape{};
+    f32 FrameTime = 0.f;
+    // Whether the mouse is pressed or the simulation paused
+    bool Enabled = false;
+};
+
+// Everything the renderer needs from a completed frame
+template <Dimension D> struct SimulationSnapshot
+{
+    SimulationState<D> State;
+    TimestepStats Stats{};
+    // Wall time the simulation thread spent on the frame
+    f32 StepTime = 0.f;
+    u64 Frames = 0;
+};
+
+// Runs a solver continuously on its own thread, paced to advance FrameTime of simulated time per FrameTime of wall
+// time. While it runs, the solver belongs to that thread: input reaches it through a lock-free command queue,
+// settings through a triple buffer, and completed frames come back through another one, so the renderer never waits
+// for a step and the simulation never waits for a frame to be drawn
+template <Dimension D> class SimulationThread
+{
+  public:
+    explicit SimulationThread(Solver<D> *p_Solver) noexcept;
+    ~SimulationThread() noexcept;
+
+    SimulationThread(const SimulationThread &) = delete;
+    SimulationThread &operator=(const SimulationThread &) = delete;
+
+    void Start(f32 p_FrameTime) noexcept;
+    // Joins the thread and applies any input it did not get to, so that the solver is up to date when this returns
+    void Stop() noexcept;
+    bool IsRunning() const noexcept;
+
+    // Returns false if the queue is full, in which case the command is dropped
+    bool Push(const SimulationCommand<D> &p_Command) noexcept;
+    void PublishSettings(const SimulationSettings &p_Settings) noexcept;
+
+    // Latest completed frame. It stays valid and unchanged until the next call
+    const SimulationSnapshot<D> &AcquireSnapshot() noexcept;
+
+  private:
+    static constexpr u32 s_CommandCapacity = 256;
+
+    void run() noexcept;
+    void applyInput() noexcept;
+    void publishSnapshot(f32 p_StepTime) noexcept;
+
+    Solver<D> *m_Solver;
+    std::thread m_Thread;
+    std::atomic<bool> m_Stop{false};
+
+    SpscQueue<SimulationCommand<D>, s_CommandCapacity> m_Commands;
+    TripleBuffer<SimulationSettings> m_Settings;
+    TripleBuffer<SimulationSnapshot<D>> m_Snapshots;
+
+    // Owned by the simulation thread
+    fvec<D> m_MousePosition{0.f};
+    f32 m_FrameTime = 1.f / 60.f;
+    u64 m_Frames = 0;
+    bool m_MousePressed = false;
+    bool m_Paused = false;
+};
+} // namespace Driz
@@ -1,378 +1,579 @@
 #include "driz/simulation/solver.hpp"
-#include "driz/app/visualization.hpp"
-#include "onyx/app/input.hpp"
+#include "driz/simulation/telemetry.hpp"
 #include "tkit/profiling/macros.hpp"
+#include <cfloat>
 
 namespace Driz
 {
-template <Dimension D>
-static f32 computeKernel(const KernelType p_Kernel, const f32 p_Radius, const f32 p_Distance) noexcept
+bool SimulationSettings::UsesGrid() const noexcept
 {
-    switch (p_Kernel)
-    {
-    case KernelType::Spiky2:
-        return Kernel<D>::Spiky2(p_Radius, p_Distance);
-    case KernelType::Spiky3:
-        return Kernel<D>::Spiky3(p_Radius, p_Distance);
-    case KernelType::Spiky5:
-        return Kernel<D>::Spiky5(p_Radius, p_Distance);
-    case KernelType::Poly6:
-        return Kernel<D>::Poly6(p_Radius, p_Distance);
-    case KernelType::CubicSpline:
-        return Kernel<D>::CubicSpline(p_Radius, p_Distance);
-    case KernelType::WendlandC2:
-        return Kernel<D>::WendlandC2(p_Radius, p_Distance);
-    case KernelType::WendlandC4:
-        return Kernel<D>::WendlandC4(p_Radius, p_Distance);
-    }
-    return 0.f;
+    return LookupMode == ParticleLookupMode::GridSingleThread || LookupMode == ParticleLookupMode::GridMultiThread ||
+           UsesDenseGrid() || UsesNeighborLists();
 }
-template <Dimension D>
-static f32 computeKernelSlope(const KernelType p_Kernel, const f32 p_Radius, const f32 p_Distance) noexcept
+bool SimulationSettings::UsesDenseGrid() const noexcept
 {
-    switch (p_Kernel)
-    {
-    case KernelType::Spiky2:
-        return Kernel<D>::Spiky2Slope(p_Radius, p_Distance);
-    case KernelType::Spiky3:
-        return Kernel<D>::Spiky3Slope(p_Radius, p_Distance);
-    case KernelType::Spiky5:
-        return Kernel<D>::Spiky5Slope(p_Radius, p_Distance);
-    case KernelType::Poly6:
-        return Kernel<D>::Poly6Slope(p_Radius, p_Distance);
-    case KernelType::CubicSpline:
-        return Kernel<D>::CubicSplineSlope(p_Radius, p_Distance);
-    case KernelType::WendlandC2:
-        return Kernel<D>::WendlandC2Slope(p_Radius, p_Distance);
-    case KernelType::WendlandC4:
-        return Kernel<D>::WendlandC4Slope(p_Radius, p_Distance);
-    }
-    return 0.f;
+    return LookupMode == ParticleLookupMode::DenseGridSingleThread ||
+           LookupMode == ParticleLookupMode::DenseGridMultiThread;
 }
-
-bool SimulationSettings::UsesGrid() const noexcept
+bool SimulationSettings::UsesNeighborLists() const noexcept
 {
-    return LookupMode == ParticleLookupMode::GridSingleThread || LookupMode == ParticleLookupMode::GridMultiThread;
+    return LookupMode == ParticleLookupMode::VerletListSingleThread ||
+           LookupMode == ParticleLookupMode::VerletListMultiThread;
 }
 bool SimulationSettings::UsesMultiThread() const noexcept
 {
-    return LookupMode == ParticleLookupMode::BruteForceMultiThread || LookupMode == ParticleLookupMode::GridMultiThread;
-}
-
-template <Dimension D> f32 Solver<D>::getInfluence(const f32 p_Distance) const noexcept
-{
-    return computeKernel<D>(Settings.KType, Settings.SmoothingRadius, p_Distance);
+    return LookupMode == ParticleLookupMode::BruteForceMultiThread ||
+           LookupMode == ParticleLookupMode::GridMultiThread ||
+           LookupMode == ParticleLookupMode::DenseGridMultiThread ||
+           LookupMode == ParticleLookupMode::VerletListMultiThread;
 }
-template <Dimension D> f32 Solver<D>::getInfluenceSlope(const f32 p_Distance) const noexcept
+bool SimulationSettings::SupportsColoring() const noexcept
 {
-    return computeKernelSlope<D>(Settings.KType, Settings.SmoothingRadius, p_Distance);
+    return LookupMode == ParticleLookupMode::DenseGridMultiThread ||
+           LookupMode == ParticleLookupMode::VerletListMultiThread;
 }
 
-template <Dimension D> f32 Solver<D>::getNearInfluence(const f32 p_Distance) const noexcept
+const char *ToString(const StepPhase p_Phase) noexcept
 {
-    return computeKernel<D>(Settings.NearKType, Settings.SmoothingRadius, p_Distance);
+    switch (p_Phase)
+    {
+    case StepPhase::BeginStep:
+        return "BeginStep";
+    case StepPhase::UpdateLookup:
+        return "UpdateLookup";
+    case StepPhase::ComputeDensities:
+        return "ComputeDensities";
+    case StepPhase::ComputeForces:
+        return "ComputeForces";
+    case StepPhase::ApplyComputedForces:
+        return "ApplyComputedForces";
+    case StepPhase::EndStep:
+        return "EndStep";
+    }
+    return "Unknown";
 }
-template <Dimension D> f32 Solver<D>::getNearInfluenceSlope(const f32 p_Distance) const noexcept
+
+TKit::Timespan StepTimings::GetTotal() const noexcept
 {
-    return computeKernelSlope<D>(Settings.NearKType, Settings.SmoothingRadius, p_Distance);
+    TKit::Timespan total{};
+    for (const TKit::Timespan &time : Phases)
+        total += time;
+    return total;
 }
 
-template <Dimension D> f32 Solver<D>::getViscosityInfluence(const f32 p_Distance) const noexcept
+namespace
 {
-    return computeKernel<D>(Settings.ViscosityKType, Settings.SmoothingRadius, p_Distance);
-}
+// Adds the time spent in its scope to a phase of the step timings. A couple of clock reads per phase are negligible
+// next to the passes they measure, so timings are always collected
+class PhaseClock
+{
+  public:
+    explicit PhaseClock(TKit::Timespan &p_Time) noexcept : m_Time(p_Time)
+    {
+    }
+    ~PhaseClock() noexcept
+    {
+        m_Time += m_Clock.GetElapsed();
+    }
+
+  private:
+    TKit::Timespan &m_Time;
+    TKit::Clock m_Clock{};
+};
+} // namespace
 
 template <Dimension D>
-fvec<D> Solver<D>::computePairwisePressureGradient(const u32 p_Index1, const u32 p_Index2,
-                                                   const f32 p_Distance) const noexcept
+fvec<D> Solver<D>::computePairwisePressureGradient(const u32 p_Index1, const u32 p_Index2, const fvec2 &p_Slopes,
+                                                   const fvec<D> &p_Direction) const noexcept
 {
-    const fvec<D> dir = (Data.State.Positions[p_Index1] - Data.State.Positions[p_Index2]) / p_Distance;
-    const fvec2 kernels = {getInfluenceSlope(p_Distance), getNearInfluenceSlope(p_Distance)};
-
     const fvec2 pressures1 = getPressureFromDensity(Data.Densities[p_Index1]);
     const fvec2 pressures2 = getPressureFromDensity(Data.Densities[p_Index2]);
 
     const fvec2 densities = 0.5f * (Data.Densities[p_Index1] + Data.Densities[p_Index2]);
-    const fvec2 coeffs = 0.5f * (pressures1 + pressures2) * kernels / densities;
+    const fvec2 coeffs = 0.5f * (pressures1 + pressures2) * p_Slopes / densities;
 
-    return (Settings.ParticleMass * (coeffs.x + coeffs.y)) * dir;
+    return (Settings.ParticleMass * (coeffs.x + coeffs.y)) * p_Direction;
 }
 
 template <Dimension D>
 fvec<D> Solver<D>::computePairwiseViscosityTerm(const u32 p_Index1, const u32 p_Index2,
-                                                const f32 p_Distance) const noexcept
+                                                const f32 p_Kernel) const noexcept
 {
     const fvec<D> diff = Data.State.Velocities[p_Index2] - Data.State.Velocities[p_Index1];
-    const f32 kernel = getViscosityInfluence(p_Distance);
-
     const f32 u = glm::length(diff);
-    return ((Settings.ViscLinearTerm + Settings.ViscQuadraticTerm * u) * kernel) * diff;
+    return ((Settings.ViscLinearTerm + Settings.ViscQuadraticTerm * u) * p_Kernel) * diff;
 }
 
 template <Dimension D>
 Solver<D>::Solver(const SimulationSettings &p_Settings, const SimulationState<D> &p_State) noexcept
     : Settings(p_Settings)
 {
-    Data.State = p_State;
-    Data.Accelerations.resize(p_State.Positions.size(), fvec<D>{0.f});
-    Data.Densities.resize(p_State.Positions.size(), fvec2{Settings.ParticleMass});
-    Data.StagedPositions.resize(p_State.Positions.size());
-    for (auto &densities : m_ThreadDensities)
-        densities.resize(p_State.Positions.size(), fvec2{0.f});
-    for (auto &accelerations : m_ThreadAccelerations)
-        accelerations.resize(p_State.Positions.size(), fvec<D>{0.f});
+    if (Core::IsFirstTouchEnabled())
+        firstTouchParticleData(p_State.Positions.size());
+
+    // Copied into the existing buffers, which may have just been first touched
+    Data.State.Positions.assign(p_State.Positions.begin(), p_State.Positions.end());
+    Data.State.Velocities.assign(p_State.Velocities.begin(), p_State.Velocities.end());
+    Data.State.Min = p_State.Min;
+    Data.State.Max = p_State.Max;
+    m_KernelParameters = Kernel<D>::CreateParameters(Settings.SmoothingRadius);
+    if (Settings.TabulatedKernels)
+        updateKernelTables();
+    SyncParticleData();
+}
+
+// Must run before anything else writes to the arrays
+template <Dimension D> void Solver<D>::firstTouchParticleData(const u32 p_Count) noexcept
+{
+    Core::FirstTouch(Data.State.Positions, p_Count);
+    Core::FirstTouch(Data.State.Velocities, p_Count);
+    Core::FirstTouch(Data.Accelerations, p_Count);
+    Core::FirstTouch(Data.StagedPositions, p_Count);
+    Core::FirstTouch(Data.Densities, p_Count);
+    Core::FirstTouch(Data.Ids, p_Count);
+}
+
+template <Dimension D> void Solver<D>::SyncParticleData() noexcept
+{
+    const u32 size = Data.State.Positions.size();
+    Data.State.Velocities.resize(size, fvec<D>{0.f});
+    Data.Accelerations.resize(size, fvec<D>{0.f});
+    Data.Densities.resize(size, fvec2{Settings.ParticleMass});
+    Data.StagedPositions.resize(size);
+
+    Data.Ids.resize(size);
+    for (u32 i = 0; i < size; ++i)
+        Data.Ids[i] = i;
+    m_NextId = size;
+    for (TKit::DynamicArray<u32> &removals : m_Removals)
+        removals.clear();
+    m_StepsSinceReorder = 0;
+    m_PredictionDeltaTime = 0.f;
+
+    // The grid order, lists and pairs describe the previous particles, and brute force modes never rebuild them
+    Lookup.Grid.ParticleIndices.clear();
+    Lookup.InvalidateNeighborLists();
+    Lookup.InvalidatePairCache();
 }
 
 template <Dimension D> void Solver<D>::BeginStep(const f32 p_DeltaTime) noexcept
 {
     TKIT_PROFILE_NSCOPE("Driz::Solver::BeginStep");
+    m_StepTimings = StepTimings{};
+    const PhaseClock clock{m_StepTimings[StepPhase::BeginStep]};
+    if (m_KernelParameters.Radius != Settings.SmoothingRadius)
+        m_KernelParameters = Kernel<D>::CreateParameters(Settings.SmoothingRadius);
+    if (Settings.TabulatedKernels)
+        updateKernelTables();
+    Lookup.InvalidatePairCache();
     Data.StagedPositions.resize(Data.State.Positions.size());
+    m_StepDeltaTime = p_DeltaTime;
+    // Counted here rather than in UpdateLookup, which is also called outside of steps, such as to draw the grid
+    ++m_StepsSinceReorder;
+
+    // The previous ApplyComputedForces may have already predicted the positions for this very time step
+    const bool predicted = m_PredictionDeltaTime == p_DeltaTime;
+    m_PredictionDeltaTime = 0.f;
 
     std::swap(Data.State.Positions, Data.StagedPositions);
-    for (u32 i = 0; i < Data.State.Positions.size(); ++i)
+    forEachParticle([this, p_DeltaTime, predicted](const u32 p_Index) {
+        if (!predicted)
+            Data.State.Positions[p_Index] =
+                Data.StagedPositions[p_Index] + Data.State.Velocities[p_Index] * p_DeltaTime;
+        Data.Densities[p_Index] = fvec2{Settings.ParticleMass};
+        Data.Accelerations[p_Index] = fvec<D>{0.f};
+    });
+}
+template <Dimension D> void Solver<D>::EndStep() noexcept
+{
+    // Removals invalidate the pair cache and the grid, so their figures are taken beforehand
+    TelemetrySample sample{};
+    if (m_Telemetry)
     {
-        Data.State.Positions[i] = Data.StagedPositions[i] + Data.State.Velocities[i] * p_DeltaTime;
-        Data.Densities[i] = fvec2{Settings.ParticleMass};
-        Data.Accelerations[i] = fvec<D>{0.f};
+        sample.Lookup = Lookup.GetTimings();
+        sample.Pairs = Lookup.GetCachedPairCount();
+        if (Settings.UsesGrid())
+        {
+            sample.Cells = Lookup.GetCellCount();
+            if (m_Telemetry->ShouldCountClashes())
+                sample.CellClashes = Lookup.CountCellClashes();
+        }
+    }
+
+    {
+        const PhaseClock clock{m_StepTimings[StepPhase::EndStep]};
+        std::swap(Data.State.Positions, Data.StagedPositions);
+        queueSinkRemovals();
+        removeQueuedParticles();
+        runEmitters(m_StepDeltaTime);
+    }
+
+    if (m_Telemetry)
+    {
+        sample.Timings = m_StepTimings;
+        sample.Particles = GetParticleCount();
+        m_Telemetry->Record(sample);
     }
 }
-template <Dimension D> void Solver<D>::EndStep() noexcept
+template <Dimension D> void Solver<D>::Step(const f32 p_DeltaTime, const fvec<D> *p_MousePos) noexcept
 {
-    std::swap(Data.State.Positions, Data.StagedPositions);
+    BeginStep(p_DeltaTime);
+    UpdateLookup();
+    ComputeDensities();
+    AddPressureAndViscosity();
+    if (p_MousePos)
+        AddMouseForce(*p_MousePos);
+    ApplyComputedForces(p_DeltaTime);
+    EndStep();
 }
+
+template <Dimension D> f32 Solver<D>::ComputeStableTimestep() const noexcept
+{
+    TKIT_PROFILE_NSCOPE("Driz::Solver::ComputeStableTimestep");
+    // Squared speed and squared acceleration maxima, one slot per thread
+    TKit::Array<fvec2, TKIT_THREAD_POOL_MAX_THREADS> maxima{};
+    const auto reduce = [this, &maxima](const u32 p_Start, const u32 p_End, const u32 p_ThreadIndex) {
+        fvec2 maximum{0.f};
+        for (u32 i = p_Start; i < p_End; ++i)
+        {
+            maximum.x = glm::max(maximum.x, glm::length2(Data.State.Velocities[i]));
+            maximum.y = glm::max(maximum.y, glm::length2(Data.Accelerations[i]));
+        }
+        maxima[p_ThreadIndex] = maximum;
+    };
+    if (Settings.UsesMultiThread())
+        Core::ForEach(0, GetParticleCount(), reduce);
+    else
+        reduce(0, GetParticleCount(), 0);
+
+    fvec2 maximum{0.f};
+    for (const fvec2 &threadMaximum : maxima)
+        maximum = glm::max(maximum, threadMaximum);
+
+    // Gravity is applied on top of the computed accelerations, so it bounds the step even in a fluid at rest
+    const f32 gravity = glm::abs(Settings.Gravity / Settings.ParticleMass);
+    const f32 speed = glm::sqrt(maximum.x);
+    const f32 acceleration = glm::sqrt(maximum.y) + gravity;
+    const f32 radius = Settings.SmoothingRadius;
+
+    f32 deltaTime = FLT_MAX;
+    if (speed > 0.f)
+        deltaTime = Settings.CourantNumber * radius / speed;
+    if (acceleration > 0.f)
+        deltaTime = glm::min(deltaTime, Settings.ForceNumber * glm::sqrt(radius / acceleration));
+    return deltaTime;
+}
+
+template <Dimension D> void Solver<D>::recordSubstep(const f32 p_DeltaTime) noexcept
+{
+    TimestepStats &stats = m_TimestepStats;
+    stats.MinDeltaTime = stats.Substeps == 0 ? p_DeltaTime : glm::min(stats.MinDeltaTime, p_DeltaTime);
+    stats.MaxDeltaTime = glm::max(stats.MaxDeltaTime, p_DeltaTime);
+    ++stats.Substeps;
+}
+
 template <Dimension D> void Solver<D>::ApplyComputedForces(const f32 p_DeltaTime) noexcept
 {
     TKIT_PROFILE_NSCOPE("Driz::Solver::ApplyComputedForces");
-
-    for (u32 i = 0; i < Data.State.Positions.size(); ++i)
-    {
-        Data.State.Velocities[i].y += Settings.Gravity * p_DeltaTime / Settings.ParticleMass;
-        Data.State.Velocities[i] += Data.Accelerations[i] * p_DeltaTime;
-        Data.StagedPositions[i] += Data.State.Velocities[i] * p_DeltaTime;
-        encase(i);
-    }
+    const PhaseClock clock{m_StepTimings[StepPhase::ApplyComputedForces]};
+
+    // Integration, boundary handling and the prediction of the next step are fused so that the particle arrays are
+    // only streamed once. Predictions go to the positions array, which becomes the staged one once the step ends
+    const f32 gravity = Settings.Gravity * p_DeltaTime / Settings.ParticleMass;
+    forEachParticle([this, p_DeltaTime, gravity](const u32 p_Index) {
+        fvec<D> &velocity = Data.State.Velocities[p_Index];
+        velocity.y += gravity;
+        velocity += Data.Accelerations[p_Index] * p_DeltaTime;
+        Data.StagedPositions[p_Index] += velocity * p_DeltaTime;
+        encase(p_Index);
+        Data.State.Positions[p_Index] = Data.StagedPositions[p_Index] + velocity * p_DeltaTime;
+    });
+    m_PredictionDeltaTime = p_DeltaTime;
 }
 template <Dimension D> void Solver<D>::AddMouseForce(const fvec<D> &p_MousePos) noexcept
 {
-    for (u32 i = 0; i < Data.State.Positions.size(); ++i)
-    {
-        const fvec<D> diff = Data.State.Positions[i] - p_MousePos;
+    const PhaseClock clock{m_StepTimings[StepPhase::ComputeForces]};
+    const f32 radius2 = Settings.MouseRadius * Settings.MouseRadius;
+    forEachParticle([this, &p_MousePos, radius2](const u32 p_Index) {
+        const fvec<D> diff = Data.State.Positions[p_Index] - p_MousePos;
         const f32 distance2 = glm::length2(diff);
-        if (distance2 < Settings.MouseRadius * Settings.MouseRadius)
+        if (distance2 < radius2)
         {
             const f32 distance = glm::sqrt(distance2);
             const f32 factor = 1.f - distance / Settings.MouseRadius;
-            Data.Accelerations[i] += (factor * Settings.MouseForce / distance) * diff;
+            Data.Accelerations[p_Index] += (factor * Settings.MouseForce / distance) * diff;
         }
-    }
+    });
 }
 
-template <Dimension D> void Solver<D>::mergeDensityArrays() noexcept
+// Symmetric accumulation writes to both particles of a pair, so multithreaded pair-wise passes need a coloring to be
+// free of races. Hashed grids and brute force cannot be colored: a hashed cell may hold particles from distant cells of
+// space, whose neighborhoods overlap those of other cells of its color. Those passes run particle-wise instead, where
+// each particle only writes its own contributions. That evaluates every kernel twice, but the alternatives, per-thread
+// copies of the particle arrays merged afterwards or atomics, cost more than that once several threads take part.
+// Dense grid and Verlet modes are colored unless the box is too large to be addressed densely, so they are the ones to
+// pick for pair-wise multithreaded passes, and the dense grid is the default lookup mode
+template <Dimension D> bool Solver<D>::IsPairWiseFallback() const noexcept
 {
-    Core::ForEach(0, Data.State.Positions.size(), [this](const u32 p_Start, const u32 p_End, const u32) {
-        const u32 threads = Core::GetThreadPool().GetThreadCount() + 1;
-        for (u32 i = 0; i < threads; ++i)
-            for (u32 j = p_Start; j < p_End; ++j)
-            {
-                Data.Densities[j] += m_ThreadDensities[i][j];
-                m_ThreadDensities[i][j] = fvec2{0.f};
-            }
-    });
+    return Settings.IterationMode == ParticleIterationMode::PairWise && Settings.UsesMultiThread() && !usesColoring();
 }
-template <Dimension D> void Solver<D>::mergeAccelerationArrays() noexcept
+template <Dimension D> bool Solver<D>::usesColoring() const noexcept
 {
-    Core::ForEach(0, Data.State.Positions.size(), [this](const u32 p_Start, const u32 p_End, const u32) {
-        const u32 threads = Core::GetThreadPool().GetThreadCount() + 1;
-        for (u32 i = 0; i < threads; ++i)
-            for (u32 j = p_Start; j < p_End; ++j)
-            {
-                Data.Accelerations[j] += m_ThreadAccelerations[i][j];
-                m_ThreadAccelerations[i][j] = fvec<D>{0.f};
-            }
-    });
+    switch (Settings.LookupMode)
+    {
+    case ParticleLookupMode::GridMultiThread:
+    case ParticleLookupMode::DenseGridMultiThread:
+        return Lookup.HasGridColoring();
+    case ParticleLookupMode::VerletListMultiThread:
+        return Lookup.HasNeighborListColoring();
+    case ParticleLookupMode::BruteForceSingleThread:
+    case ParticleLookupMode::BruteForceMultiThread:
+    case ParticleLookupMode::GridSingleThread:
+    case ParticleLookupMode::DenseGridSingleThread:
+    case ParticleLookupMode::VerletListSingleThread:
+        return false;
+    }
+    return false;
 }
 
 template <Dimension D> void Solver<D>::ComputeDensities() noexcept
 {
     TKIT_PROFILE_NSCOPE("Driz::Solver::ComputeDensities");
+    const PhaseClock clock{m_StepTimings[StepPhase::ComputeDensities]};
+
+    // Kernels are chosen once here, so that the accumulation loops below are free of any dispatch
+    DensityAccumulator accumulator = &Solver::accumulateTabulatedDensities;
+    if (!Settings.TabulatedKernels)
+        DispatchKernels(
+            [&accumulator](const auto p_Kernel, const auto p_NearKernel) {
+                accumulator = &Solver::accumulateDensities<decltype(p_Kernel)::value, decltype(p_NearKernel)::value>;
+            },
+            Settings.KType, Settings.NearKType);
+
+    const bool multiThread = Settings.UsesMultiThread();
+    if (Settings.IterationMode == ParticleIterationMode::ParticleWise || IsPairWiseFallback())
+    {
+        streamNeighbors(
+            [this, accumulator](const PairSpan &p_Pairs) { (this->*accumulator)(p_Pairs, Data.Densities, false); });
+        return;
+    }
 
-    const auto pairWiseST = [this](const u32 p_Index1, const u32 p_Index2, const f32 p_Distance) {
-        const fvec2 densities = Settings.ParticleMass * fvec2{getInfluence(p_Distance), getNearInfluence(p_Distance)};
-        Data.Densities[p_Index1] += densities;
-        Data.Densities[p_Index2] += densities;
+    const auto accumulate = [this, accumulator](const PairSpan &p_Pairs) {
+        (this->*accumulator)(p_Pairs, Data.Densities, true);
     };
-    const auto pairWiseMT = [this](const u32 p_Index1, const u32 p_Index2, const f32 p_Distance,
-                                   const u32 p_ThreadIndex) {
-        const fvec2 densities = Settings.ParticleMass * fvec2{getInfluence(p_Distance), getNearInfluence(p_Distance)};
+    if (!Settings.CachePairs)
+    {
+        streamPairs(accumulate);
+        return;
+    }
 
-        m_ThreadDensities[p_ThreadIndex][p_Index1] += densities;
-        m_ThreadDensities[p_ThreadIndex][p_Index2] += densities;
-    };
+    // Pairs are only gathered here, and the cache is then consumed segment by segment
+    Lookup.BeginPairCache(multiThread);
+    forEachPairWithinSmoothingRadius(
+        [this](const u32 p_Index1, const u32 p_Index2, const f32 p_Distance2) {
+            Lookup.CachePair(p_Index1, p_Index2, p_Distance2);
+        },
+        [this](const u32 p_Index1, const u32 p_Index2, const f32 p_Distance2, const u32 p_ThreadIndex) {
+            Lookup.CachePair(p_Index1, p_Index2, p_Distance2, p_ThreadIndex);
+        },
+        [this](const u32 p_Color, const u32 p_ThreadIndex) { Lookup.EndPairCacheColor(p_Color, p_ThreadIndex); });
+    streamCachedPairs(accumulate);
+}
+template <Dimension D> void Solver<D>::AddPressureAndViscosity() noexcept
+{
+    TKIT_PROFILE_NSCOPE("Driz::Solver::PressureAndViscosity");
+    const PhaseClock clock{m_StepTimings[StepPhase::ComputeForces]};
+
+    AccelerationAccumulator accumulator = &Solver::accumulateTabulatedAccelerations;
+    if (!Settings.TabulatedKernels)
+        DispatchKernels(
+            [&accumulator](const auto p_Kernel, const auto p_NearKernel, const auto p_ViscosityKernel) {
+                accumulator = &Solver::accumulateAccelerations<decltype(p_Kernel)::value,
+                                                               decltype(p_NearKernel)::value,
+                                                               decltype(p_ViscosityKernel)::value>;
+            },
+            Settings.KType, Settings.NearKType, Settings.ViscosityKType);
+
+    if (Settings.IterationMode == ParticleIterationMode::ParticleWise || IsPairWiseFallback())
+    {
+        streamNeighbors([this, accumulator](const PairSpan &p_Pairs) {
+            (this->*accumulator)(p_Pairs, Data.Accelerations, false);
+        });
+        return;
+    }
 
-    const auto bruteForcePairWiseST = [this, pairWiseST]() { Lookup.ForEachPairBruteForceST(pairWiseST); };
-    const auto bruteForcePairWiseMT = [this, pairWiseMT]() {
-        Lookup.ForEachPairBruteForceMT(pairWiseMT);
-        mergeDensityArrays();
+    const auto accumulate = [this, accumulator](const PairSpan &p_Pairs) {
+        (this->*accumulator)(p_Pairs, Data.Accelerations, true);
     };
+    if (Settings.CachePairs && Lookup.HasPairCache())
+        streamCachedPairs(accumulate);
+    else
+        streamPairs(accumulate);
+}
 
-    const auto gridPairWiseST = [this, pairWiseST]() { Lookup.ForEachPairGridST(pairWiseST); };
-    const auto gridPairWiseMT = [this, pairWiseMT]() {
-        Lookup.ForEachPairGridMT(pairWiseMT);
-        mergeDensityArrays();
-    };
+template <Dimension D>
+void Solver<D>::gatherDistances(const PairSpan &p_Pairs, const u32 p_Start, const u32 p_Size,
+                                f32 *p_Distances) noexcept
+{
+    const f32 *squaredDistances = p_Pairs.SquaredDistances + p_Start;
+    for (u32 i = 0; i < p_Size; ++i)
+        p_Distances[i] = glm::sqrt(squaredDistances[i]);
+}
 
-    const auto bruteForceParticleWiseST = [this]() {
-        for (u32 i = 0; i < Data.State.Positions.size(); ++i)
-        {
-            fvec2 densities{Settings.ParticleMass};
-            Lookup.ForEachParticleBruteForce(i, [this, &densities](const u32, const f32 p_Distance) {
-                densities += Settings.ParticleMass * fvec2{getInfluence(p_Distance), getNearInfluence(p_Distance)};
-            });
-            Data.Densities[i] = densities;
-        }
-    };
-    const auto bruteForceParticleWiseMT = [this]() {
-        Core::ForEach(0, Data.State.Positions.size(), [this](const u32 p_Start, const u32 p_End, const u32) {
-            for (u32 i = p_Start; i < p_End; ++i)
-            {
-                fvec2 densities{Settings.ParticleMass};
-                Lookup.ForEachParticleBruteForce(i, [this, &densities](const u32, const f32 p_Distance) {
-                    densities += Settings.ParticleMass * fvec2{getInfluence(p_Distance), getNearInfluence(p_Distance)};
-                });
-                Data.Densities[i] = densities;
-            }
-        });
-    };
+// The kernel types still select the accumulator once per pass, but the formulas run through the batched Kernel<D>
+// entry points: distances are gathered into contiguous lanes, evaluated with the widest instruction set the CPU has,
+// and the loops below are left with the scatter alone
+template <Dimension D>
+template <KernelType K, KernelType NK>
+void Solver<D>::accumulateDensities(const PairSpan &p_Pairs, SimArray<Density> &p_Densities,
+                                    const bool p_Symmetric) const noexcept
+{
+    TKit::Array<f32, s_PairBatchSize> distances;
+    TKit::Array<f32, s_PairBatchSize> influences;
+    TKit::Array<f32, s_PairBatchSize> nearInfluences;
+    for (u32 start = 0; start < p_Pairs.Size; start += s_PairBatchSize)
+    {
+        const u32 size = glm::min(p_Pairs.Size - start, s_PairBatchSize);
+        gatherDistances(p_Pairs, start, size, distances.data());
+        Kernel<D>::Evaluate(K, m_KernelParameters, distances.data(), influences.data(), size);
+        Kernel<D>::Evaluate(NK, m_KernelParameters, distances.data(), nearInfluences.data(), size);
 
-    const auto gridParticleWiseST = [this]() {
-        for (u32 i = 0; i < Data.State.Positions.size(); ++i)
+        for (u32 i = 0; i < size; ++i)
         {
-            fvec2 densities{Settings.ParticleMass};
-            Lookup.ForEachParticleGrid(i, [this, &densities](const u32, const f32 p_Distance) {
-                densities += Settings.ParticleMass * fvec2{getInfluence(p_Distance), getNearInfluence(p_Distance)};
-            });
-            Data.Densities[i] = densities;
+            const fvec2 densities = Settings.ParticleMass * fvec2{influences[i], nearInfluences[i]};
+            p_Densities[p_Pairs.Indices1[start + i]] += densities;
+            if (p_Symmetric)
+                p_Densities[p_Pairs.Indices2[start + i]] += densities;
         }
-    };
-    const auto gridParticleWiseMT = [this]() {
-        Core::ForEach(0, Data.State.Positions.size(), [this](const u32 p_Start, const u32 p_End, const u32) {
-            for (u32 i = p_Start; i < p_End; ++i)
-            {
-                fvec2 densities{Settings.ParticleMass};
-                Lookup.ForEachParticleGrid(i, [this, &densities](const u32, const f32 p_Distance) {
-                    densities += Settings.ParticleMass * fvec2{getInfluence(p_Distance), getNearInfluence(p_Distance)};
-                });
-                Data.Densities[i] = densities;
-            }
-        });
-    };
-
-    forEachWithinSmoothingRadius(bruteForcePairWiseST, bruteForcePairWiseMT, gridPairWiseST, gridPairWiseMT,
-                                 bruteForceParticleWiseST, bruteForceParticleWiseMT, gridParticleWiseST,
-                                 gridParticleWiseMT);
+    }
 }
-template <Dimension D> void Solver<D>::AddPressureAndViscosity() noexcept
+
+template <Dimension D>
+template <KernelType K, KernelType NK, KernelType VK>
+void Solver<D>::accumulateAccelerations(const PairSpan &p_Pairs, SimArray<fvec<D>> &p_Accelerations,
+                                        const bool p_Symmetric) const noexcept
 {
-    TKIT_PROFILE_NSCOPE("Driz::Solver::PressureAndViscosity");
-    const auto computeAccelerations = [this](const u32 p_Index1, const u32 p_Index2, const f32 p_Distance) {
-        const fvec<D> gradient = computePairwisePressureGradient(p_Index1, p_Index2, p_Distance);
-        const fvec<D> term = computePairwiseViscosityTerm(p_Index1, p_Index2, p_Distance);
+    const auto &positions = Data.State.Positions;
+    TKit::Array<f32, s_PairBatchSize> distances;
+    TKit::Array<f32, s_PairBatchSize> slopes;
+    TKit::Array<f32, s_PairBatchSize> nearSlopes;
+    TKit::Array<f32, s_PairBatchSize> viscosities;
+    for (u32 start = 0; start < p_Pairs.Size; start += s_PairBatchSize)
+    {
+        const u32 size = glm::min(p_Pairs.Size - start, s_PairBatchSize);
+        gatherDistances(p_Pairs, start, size, distances.data());
+        Kernel<D>::EvaluateSlope(K, m_KernelParameters, distances.data(), slopes.data(), size);
+        Kernel<D>::EvaluateSlope(NK, m_KernelParameters, distances.data(), nearSlopes.data(), size);
+        Kernel<D>::Evaluate(VK, m_KernelParameters, distances.data(), viscosities.data(), size);
 
-        const fvec<D> acc1 = term - gradient / Data.Densities[p_Index1].x;
-        const fvec<D> acc2 = term - gradient / Data.Densities[p_Index2].x;
+        for (u32 i = 0; i < size; ++i)
+        {
+            const u32 pair = start + i;
+            const u32 index1 = p_Pairs.Indices1[pair];
+            const u32 index2 = p_Pairs.Indices2[pair];
 
-        return std::make_pair(acc1, acc2);
-    };
+            const fvec<D> offset = p_Pairs.Offsets ? p_Pairs.Offsets[pair] : positions[index1] - positions[index2];
+            const fvec<D> dir = offset / distances[i];
 
-    const auto pairWiseST = [this, computeAccelerations](const u32 p_Index1, const u32 p_Index2, const f32 p_Distance) {
-        const auto [acc1, acc2] = computeAccelerations(p_Index1, p_Index2, p_Distance);
-        Data.Accelerations[p_Index1] += acc1;
-        Data.Accelerations[p_Index2] -= acc2;
-    };
-    const auto pairWiseMT = [this, computeAccelerations](const u32 p_Index1, const u32 p_Index2, const f32 p_Distance,
-                                                         const u32 p_ThreadIndex) {
-        const auto [acc1, acc2] = computeAccelerations(p_Index1, p_Index2, p_Distance);
-        m_ThreadAccelerations[p_ThreadIndex][p_Index1] += acc1;
-        m_ThreadAccelerations[p_ThreadIndex][p_Index2] -= acc2;
-    };
+            const fvec<D> gradient =
+                computePairwisePressureGradient(index1, index2, fvec2{slopes[i], nearSlopes[i]}, dir);
+            const fvec<D> term = computePairwiseViscosityTerm(index1, index2, viscosities[i]);
 
-    const auto bruteForcePairWiseST = [this, pairWiseST]() { Lookup.ForEachPairBruteForceST(pairWiseST); };
-    const auto bruteForcePairWiseMT = [this, pairWiseMT]() {
-        Lookup.ForEachPairBruteForceMT(pairWiseMT);
-        mergeAccelerationArrays();
-    };
+            p_Accelerations[index1] += term - gradient / Data.Densities[index1].x;
+            if (p_Symmetric)
+                p_Accelerations[index2] -= term - gradient / Data.Densities[index2].x;
+        }
+    }
+}
 
-    const auto gridPairWiseST = [this, pairWiseST]() { Lookup.ForEachPairGridST(pairWiseST); };
-    const auto gridPairWiseMT = [this, pairWiseMT]() {
-        Lookup.ForEachPairGridMT(pairWiseMT);
-        mergeAccelerationArrays();
-    };
+template <Dimension D>
+void Solver<D>::accumulateTabulatedDensities(const PairSpan &p_Pairs, SimArray<Density> &p_Densities,
+                                             const bool p_Symmetric) const noexcept
+{
+    for (u32 i = 0; i < p_Pairs.Size; ++i)
+    {
+        const f32 distance2 = p_Pairs.SquaredDistances[i];
+        const fvec2 densities = Settings.ParticleMass * fvec2{m_KernelTables.Influence.Evaluate(distance2),
+                                                              m_KernelTables.NearInfluence.Evaluate(distance2)};
+        p_Densities[p_Pairs.Indices1[i]] += densities;
+        if (p_Symmetric)
+            p_Densities[p_Pairs.Indices2[i]] += densities;
+    }
+}
 
-    const auto bruteForceParticleWiseST = [this]() {
-        for (u32 i = 0; i < Data.State.Positions.size(); ++i)
-        {
-            fvec<D> gradient{0.f};
-            fvec<D> vterm{0.f};
-            Lookup.ForEachParticleBruteForce(i, [this, i, &gradient, &vterm](const u32 p_Index, const f32 p_Distance) {
-                const fvec<D> g = computePairwisePressureGradient(i, p_Index, p_Distance);
-                const fvec<D> t = computePairwiseViscosityTerm(i, p_Index, p_Distance);
-                gradient += g;
-                vterm += t;
-            });
-            Data.Accelerations[i] = vterm - gradient / Data.Densities[i].x;
-        }
-    };
-    const auto bruteForceParticleWiseMT = [this]() {
-        Core::ForEach(0, Data.State.Positions.size(), [this](const u32 p_Start, const u32 p_End, const u32) {
-            for (u32 i = p_Start; i < p_End; ++i)
-            {
-                fvec<D> gradient{0.f};
-                fvec<D> vterm{0.f};
-                Lookup.ForEachParticleBruteForce(
-                    i, [this, i, &gradient, &vterm](const u32 p_Index, const f32 p_Distance) {
-                        const fvec<D> g = computePairwisePressureGradient(i, p_Index, p_Distance);
-                        const fvec<D> t = computePairwiseViscosityTerm(i, p_Index, p_Distance);
-                        gradient += g;
-                        vterm += t;
-                    });
-                Data.Accelerations[i] = vterm - gradient / Data.Densities[i].x;
-            }
-        });
-    };
+template <Dimension D>
+void Solver<D>::accumulateTabulatedAccelerations(const PairSpan &p_Pairs, SimArray<fvec<D>> &p_Accelerations,
+                                                 const bool p_Symmetric) const noexcept
+{
+    const auto &positions = Data.State.Positions;
+    for (u32 i = 0; i < p_Pairs.Size; ++i)
+    {
+        const u32 index1 = p_Pairs.Indices1[i];
+        const u32 index2 = p_Pairs.Indices2[i];
+        const f32 distance2 = p_Pairs.SquaredDistances[i];
+
+        // The slopes are already divided by the distance, so the offset stands in for the direction
+        const fvec<D> offset = p_Pairs.Offsets ? p_Pairs.Offsets[i] : positions[index1] - positions[index2];
+        const fvec2 slopes{m_KernelTables.InfluenceSlope.Evaluate(distance2),
+                           m_KernelTables.NearInfluenceSlope.Evaluate(distance2)};
+
+        const fvec<D> gradient = computePairwisePressureGradient(index1, index2, slopes, offset);
+        const fvec<D> term =
+            computePairwiseViscosityTerm(index1, index2, m_KernelTables.Viscosity.Evaluate(distance2));
+
+        p_Accelerations[index1] += term - gradient / Data.Densities[index1].x;
+        if (p_Symmetric)
+            p_Accelerations[index2] -= term - gradient / Data.Densities[index2].x;
+    }
+}
 
-    const auto gridParticleWiseST = [this]() {
-        for (u32 i = 0; i < Data.State.Positions.size(); ++i)
-        {
-            fvec<D> gradient{0.f};
-            fvec<D> vterm{0.f};
-            Lookup.ForEachParticleGrid(i, [this, i, &gradient, &vterm](const u32 p_Index, const f32 p_Distance) {
-                const fvec<D> g = computePairwisePressureGradient(i, p_Index, p_Distance);
-                const fvec<D> t = computePairwiseViscosityTerm(i, p_Index, p_Distance);
-                gradient += g;
-                vterm += t;
-            });
-            Data.Accelerations[i] = vterm - gradient / Data.Densities[i].x;
-        }
+template <Dimension D> void Solver<D>::updateKernelTables() noexcept
+{
+    if (m_KernelTables.Radius == m_KernelParameters.Radius && m_KernelTables.KType == Settings.KType &&
+        m_KernelTables.NearKType == Settings.NearKType && m_KernelTables.ViscosityKType == Settings.ViscosityKType)
+        return;
+    TKIT_PROFILE_NSCOPE("Driz::Solver::UpdateKernelTables");
+
+    m_KernelTables.Radius = m_KernelParameters.Radius;
+    m_KernelTables.KType = Settings.KType;
+    m_KernelTables.NearKType = Settings.NearKType;
+    m_KernelTables.ViscosityKType = Settings.ViscosityKType;
+
+    const f32 radius = m_KernelParameters.Radius;
+    const KernelParameters &params = m_KernelParameters;
+    const auto tabulate = [radius, &params](KernelTable &p_Table, const KernelType p_Type) {
+        p_Table.Build(radius, [p_Type, &params](const f32 p_Distance2) {
+            return Kernel<D>::Evaluate(p_Type, params, glm::sqrt(p_Distance2));
+        });
     };
-    const auto gridParticleWiseMT = [this]() {
-        Core::ForEach(0, Data.State.Positions.size(), [this](const u32 p_Start, const u32 p_End, const u32) {
-            for (u32 i = p_Start; i < p_End; ++i)
-            {
-                fvec<D> gradient{0.f};
-                fvec<D> vterm{0.f};
-                Lookup.ForEachParticleGrid(i, [this, i, &gradient, &vterm](const u32 p_Index, const f32 p_Distance) {
-                    const fvec<D> g = computePairwisePressureGradient(i, p_Index, p_Distance);
-                    const fvec<D> t = computePairwiseViscosityTerm(i, p_Index, p_Distance);
-                    gradient += g;
-                    vterm += t;
-                });
-                Data.Accelerations[i] = vterm - gradient / Data.Densities[i].x;
-            }
+    // Slope over distance diverges at the origin for some kernels, so the first sample is held over the first step
+    const f32 minDistance2 = radius * radius / static_cast<f32>(KernelTable::Resolution);
+    const auto tabulateSlope = [radius, minDistance2, &params](KernelTable &p_Table, const KernelType p_Type) {
+        p_Table.Build(radius, [p_Type, minDistance2, &params](const f32 p_Distance2) {
+            const f32 distance = glm::sqrt(glm::max(p_Distance2, minDistance2));
+            return Kernel<D>::EvaluateSlope(p_Type, params, distance) / distance;
         });
     };
-    forEachWithinSmoothingRadius(bruteForcePairWiseST, bruteForcePairWiseMT, gridPairWiseST, gridPairWiseMT,
-                                 bruteForceParticleWiseST, bruteForceParticleWiseMT, gridParticleWiseST,
-                                 gridParticleWiseMT);
+
+    tabulate(m_KernelTables.Influence, Settings.KType);
+    tabulate(m_KernelTables.NearInfluence, Settings.NearKType);
+    tabulate(m_KernelTables.Viscosity, Settings.ViscosityKType);
+    tabulateSlope(m_KernelTables.InfluenceSlope, Settings.KType);
+    tabulateSlope(m_KernelTables.NearInfluenceSlope, Settings.NearKType);
+}
+
+template <Dimension D> f32 Solver<D>::GetKernelTableError() const noexcept
+{
+    const KernelTables &tables = m_KernelTables;
+    return glm::max(glm::max(tables.Influence.GetRelativeError(), tables.NearInfluence.GetRelativeError()),
+                    glm::max(glm::max(tables.InfluenceSlope.GetRelativeError(),
+                                      tables.NearInfluenceSlope.GetRelativeError()),
+                             tables.Viscosity.GetRelativeError()));
+}
+
+template <Dimension D> typename Solver<D>::PairSpan Solver<D>::PairBatch::GetSpan() const noexcept
+{
+    return PairSpan{Indices1.data(), Indices2.data(), SquaredDistances.data(), nullptr, Size};
 }
 
 template <Dimension D> fvec2 Solver<D>::getPressureFromDensity(const Density &p_Density) const noexcept
@@ -384,17 +585,39 @@ template <Dimension D> fvec2 Solver<D>::getPressureFromDensity(const Density &p_
 
 template <Dimension D> void Solver<D>::UpdateLookup() noexcept
 {
+    const PhaseClock clock{m_StepTimings[StepPhase::UpdateLookup]};
+    Lookup.ResetTimings();
     Lookup.SetPositions(&Data.State.Positions);
+
+    const f32 radius = Settings.SmoothingRadius;
+    const bool multiThread = Settings.UsesMultiThread();
     switch (Settings.LookupMode)
     {
     case ParticleLookupMode::BruteForceMultiThread:
     case ParticleLookupMode::BruteForceSingleThread:
-        Lookup.UpdateBruteForceLookup(Settings.SmoothingRadius);
-        break;
+        Lookup.UpdateBruteForceLookup(radius, multiThread);
+        return;
     case ParticleLookupMode::GridMultiThread:
     case ParticleLookupMode::GridSingleThread:
-        Lookup.UpdateGridLookup(Settings.SmoothingRadius);
-        break;
+        Lookup.UpdateGridLookup(radius, multiThread);
+        reorderParticlesIfDue();
+        return;
+    case ParticleLookupMode::DenseGridMultiThread:
+    case ParticleLookupMode::DenseGridSingleThread:
+        Lookup.UpdateDenseGridLookup(radius, Data.State.Min, Data.State.Max, multiThread);
+        reorderParticlesIfDue();
+        return;
+    case ParticleLookupMode::VerletListMultiThread:
+    case ParticleLookupMode::VerletListSingleThread:
+        if (Lookup.AreNeighborListsValid(radius, Settings.VerletSkin, multiThread))
+            return;
+        // Reordering is only possible right before rebuilding the lists, as it would invalidate them otherwise. The
+        // lists are built particle by particle and pairs come from them afterwards, so the grid needs no half-shell
+        Lookup.UpdateDenseGridLookup(radius + Settings.VerletSkin, Data.State.Min, Data.State.Max, multiThread,
+                                     false);
+        reorderParticlesIfDue();
+        Lookup.UpdateNeighborLists(radius, Settings.VerletSkin, multiThread);
+        return;
     }
 }
 
@@ -407,42 +630,268 @@ template <Dimension D> void Solver<D>::UpdateAllLookups() noexcept
 
 template <Dimension D> void Solver<D>::AddParticle(const fvec<D> &p_Position) noexcept
 {
-    Data.State.Positions.push_back(p_Position);
-    Data.State.Velocities.push_back(fvec<D>{0.f});
-    Data.Accelerations.push_back(fvec<D>{0.f});
-    Data.Densities.push_back(fvec2{Settings.ParticleMass});
-    for (auto &densities : m_ThreadDensities)
-        densities.push_back(fvec2{0.f});
-    for (auto &accelerations : m_ThreadAccelerations)
-        accelerations.push_back(fvec<D>{0.f});
+    AddParticles(std::span<const fvec<D>>{&p_Position, 1});
 }
 
-template <Dimension D> void Solver<D>::encase(const u32 p_Index) noexcept
+template <Dimension D>
+void Solver<D>::AddParticles(const std::span<const fvec<D>> p_Positions, const fvec<D> &p_Velocity) noexcept
 {
-    const f32 factor = 1.f - Settings.EncaseFriction;
-    for (u32 j = 0; j < D; ++j)
+    const u32 start = GetParticleCount();
+    const u32 size = start + static_cast<u32>(p_Positions.size());
+    Data.State.Positions.resize_uninitialized(size);
+    Data.State.Velocities.resize_uninitialized(size);
+    Data.Accelerations.resize_uninitialized(size);
+    Data.StagedPositions.resize_uninitialized(size);
+    Data.Densities.resize_uninitialized(size);
+    Data.Ids.resize_uninitialized(size);
+
+    // Between steps, the staged positions hold the prediction for the next one, which new particles get as well so
+    // that the rest keep theirs
+    const u32 firstId = m_NextId;
+    m_NextId += size - start;
+    forEachParticle(start, size, [this, start, firstId, &p_Positions, &p_Velocity](const u32 p_Index) {
+        const fvec<D> &position = p_Positions[p_Index - start];
+        Data.State.Positions[p_Index] = position;
+        Data.State.Velocities[p_Index] = p_Velocity;
+        Data.Accelerations[p_Index] = fvec<D>{0.f};
+        Data.StagedPositions[p_Index] = position + p_Velocity * m_PredictionDeltaTime;
+        Data.Densities[p_Index] = fvec2{Settings.ParticleMass};
+        Data.Ids[p_Index] = firstId + p_Index - start;
+    });
+}
+
+template <Dimension D> void Solver<D>::AddParticles(const ParticleShape<D> &p_Shape) noexcept
+{
+    SimArray<fvec<D>> positions;
+    GenerateShape<D>(p_Shape, positions);
+    AddParticles(positions, p_Shape.Velocity);
+}
+
+template <Dimension D> void Solver<D>::RemoveParticle(const u32 p_Index) noexcept
+{
+    if (p_Index < GetParticleCount())
+        m_Removals[0].push_back(p_Index);
+}
+
+template <Dimension D> static bool isInside(const fvec<D> &p_Position, const FlowVolume &p_Volume) noexcept
+{
+    for (u32 i = 0; i < D; ++i)
+        if (p_Position[i] < p_Volume.Min[i] || p_Position[i] > p_Volume.Max[i])
+            return false;
+    return true;
+}
+
+template <Dimension D> void Solver<D>::queueSinkRemovals() noexcept
+{
+    if (Settings.Sinks.empty())
+        return;
+
+    TKIT_PROFILE_NSCOPE("Driz::Solver::QueueSinkRemovals");
+    const auto queue = [this](const u32 p_Start, const u32 p_End, const u32 p_ThreadIndex) {
+        for (u32 i = p_Start; i < p_End; ++i)
+            for (const FlowVolume &sink : Settings.Sinks)
+                if (sink.Enabled && isInside<D>(Data.State.Positions[i], sink))
+                {
+                    m_Removals[p_ThreadIndex].push_back(i);
+                    break;
+                }
+    };
+    if (Settings.UsesMultiThread())
+        Core::ForEach(0, GetParticleCount(), queue);
+    else
+        queue(0, GetParticleCount(), 0);
+}
+
+// Each removed particle is overwritten by the last one, so the arrays themselves are only touched once per removal.
+// Going from the highest index down guarantees that the last particle is never one that is still to be removed
+template <typename T> static void swapRemove(SimArray<T> &p_Array, const TKit::DynamicArray<u32> &p_Removals) noexcept
+{
+    u32 size = p_Array.size();
+    for (const u32 index : p_Removals)
+        p_Array[index] = p_Array[--size];
+    p_Array.resize(size);
+}
+
+template <Dimension D> void Solver<D>::removeQueuedParticles() noexcept
+{
+    TKit::DynamicArray<u32> &removals = m_Removals[0];
+    for (u32 i = 1; i < m_Removals.size(); ++i)
+    {
+        removals.insert(removals.end(), m_Removals[i].begin(), m_Removals[i].end());
+        m_Removals[i].clear();
+    }
+    if (removals.empty())
+        return;
+
+    TKIT_PROFILE_NSCOPE("Driz::Solver::RemoveParticles");
+    std::sort(removals.begin(), removals.end(), std::greater<u32>{});
+    removals.erase(std::unique(removals.begin(), removals.end()), removals.end());
+
+    // The grid order from this step is kept as the seed of the next build, which only needs to know where every
+    // particle went. Slots past the surviving range are the only ones that move, so the mapping is built by replaying
+    // the swaps. Building and applying it is a pass over every particle, so a step with removals costs O(N) on top of
+    // the swaps. Steps without removals skip all of it
+    const u32 count = GetParticleCount();
+    Core::ReserveArena(2ull * count * sizeof(u32) + 1024);
+    u32 *newIndices = Core::GetArena().Allocate<u32>(count);
+    u32 *slots = Core::GetArena().Allocate<u32>(count);
+    for (u32 i = 0; i < count; ++i)
+        newIndices[i] = slots[i] = i;
+
+    u32 size = count;
+    for (const u32 index : removals)
     {
-        if (Data.StagedPositions[p_Index][j] - Settings.ParticleRadius < Data.State.Min[j])
+        const u32 moved = slots[--size];
+        newIndices[slots[index]] = UINT32_MAX;
+        if (index != size)
         {
-            Data.StagedPositions[p_Index][j] = Data.State.Min[j] + Settings.ParticleRadius;
-            Data.State.Velocities[p_Index][j] = -factor * Data.State.Velocities[p_Index][j];
+            newIndices[moved] = index;
+            slots[index] = moved;
         }
-        else if (Data.StagedPositions[p_Index][j] + Settings.ParticleRadius > Data.State.Max[j])
+    }
+    Lookup.RemapParticles(newIndices, count);
+    Core::GetArena().Reset();
+
+    swapRemove(Data.State.Positions, removals);
+    swapRemove(Data.State.Velocities, removals);
+    swapRemove(Data.StagedPositions, removals);
+    swapRemove(Data.Accelerations, removals);
+    swapRemove(Data.Densities, removals);
+    swapRemove(Data.Ids, removals);
+    removals.clear();
+}
+
+template <Dimension D> void Solver<D>::runEmitters(const f32 p_DeltaTime) noexcept
+{
+    // A budget is always under one particle, so dropping them loses at most a fraction of a particle per emitter.
+    // Keeping them would hand the budget of a removed emitter to the one that takes its slot
+    const u32 emitters = Settings.Emitters.size();
+    if (emitters != m_BudgetedEmitters)
+    {
+        m_EmissionBudgets.fill(0.f);
+        m_BudgetedEmitters = emitters;
+    }
+
+    SimArray<fvec<D>> positions;
+    for (u32 i = 0; i < emitters; ++i)
+    {
+        const FlowVolume &emitter = Settings.Emitters[i];
+        if (!emitter.Enabled)
+            continue;
+
+        m_EmissionBudgets[i] += emitter.Rate * p_DeltaTime;
+        const u32 count = static_cast<u32>(m_EmissionBudgets[i]);
+        if (count == 0)
+            continue;
+        m_EmissionBudgets[i] -= static_cast<f32>(count);
+
+        // Random placement keeps the inflow free of the lattice artifacts a fixed pattern would repeat every step
+        std::uniform_real_distribution<f32> unit{0.f, 1.f};
+        positions.clear();
+        for (u32 j = 0; j < count; ++j)
         {
-            Data.StagedPositions[p_Index][j] = Data.State.Max[j] - Settings.ParticleRadius;
-            Data.State.Velocities[p_Index][j] = -factor * Data.State.Velocities[p_Index][j];
+            fvec<D> position;
+            for (u32 k = 0; k < D; ++k)
+                position[k] = emitter.Min[k] + unit(m_Random) * (emitter.Max[k] - emitter.Min[k]);
+            positions.push_back(position);
         }
+        AddParticles(positions, fvec<D>{emitter.Velocity});
+    }
+}
+
+// Written with selects rather than branches so that it does not get in the way of vectorizing the integration
+template <Dimension D> void Solver<D>::encase(const u32 p_Index) noexcept
+{
+    const f32 factor = 1.f - Settings.EncaseFriction;
+    fvec<D> &position = Data.StagedPositions[p_Index];
+    fvec<D> &velocity = Data.State.Velocities[p_Index];
+    for (u32 j = 0; j < D; ++j)
+    {
+        const f32 low = Data.State.Min[j] + Settings.ParticleRadius;
+        const f32 high = Data.State.Max[j] - Settings.ParticleRadius;
+        const bool outside = position[j] < low || position[j] > high;
+
+        // The lower bound wins when the box is too small for the particle, as it always has
+        position[j] = glm::max(glm::min(position[j], high), low);
+        velocity[j] = outside ? -factor * velocity[j] : velocity[j];
     }
 }
 
-template <Dimension D> void Solver<D>::DrawBoundingBox(Onyx::RenderContext<D> *p_Context) const noexcept
+template <typename T> static void permute(SimArray<T> &p_Array, const SimArray<u32> &p_Order) noexcept
+{
+    const u32 size = p_Order.size();
+    Core::ReserveArena(size * sizeof(T) + 1024);
+    T *buffer = Core::GetArena().Allocate<T>(size);
+    Core::ForEach(0, size, [&p_Array, &p_Order, buffer](const u32 p_Start, const u32 p_End, const u32) {
+        for (u32 i = p_Start; i < p_End; ++i)
+            buffer[i] = p_Array[p_Order[i]];
+    });
+    Core::ForEach(0, size, [&p_Array, buffer](const u32 p_Start, const u32 p_End, const u32) {
+        for (u32 i = p_Start; i < p_End; ++i)
+            p_Array[i] = buffer[i];
+    });
+    Core::GetArena().Reset();
+}
+
+// Physically sorts all particle data by grid cell so that neighbor traversal walks contiguous memory
+template <Dimension D> void Solver<D>::reorderParticlesIfDue() noexcept
 {
-    Visualization<D>::DrawBoundingBox(p_Context, Data.State.Min, Data.State.Max,
-                                      Onyx::Color::FromHexadecimal("A6B1E1"));
+    if (Settings.ReorderInterval == 0 || m_StepsSinceReorder < Settings.ReorderInterval)
+        return;
+
+    TKIT_PROFILE_NSCOPE("Driz::Solver::ReorderParticles");
+    SimArray<u32> &order = Lookup.Grid.ParticleIndices;
+    if (order.size() != Data.State.Positions.size())
+        return;
+    m_StepsSinceReorder = 0;
+
+    permute(Data.State.Positions, order);
+    permute(Data.State.Velocities, order);
+    permute(Data.StagedPositions, order);
+    permute(Data.Accelerations, order);
+    permute(Data.Densities, order);
+    permute(Data.Ids, order);
+
+    // Removals queued earlier in the step still point to the slots particles had before the reorder
+    if (std::any_of(m_Removals.begin(), m_Removals.end(),
+                    [](const TKit::DynamicArray<u32> &p_Removals) { return !p_Removals.empty(); }))
+    {
+        Core::ReserveArena(order.size() * sizeof(u32) + 1024);
+        u32 *newIndices = Core::GetArena().Allocate<u32>(order.size());
+        for (u32 i = 0; i < order.size(); ++i)
+            newIndices[order[i]] = i;
+        for (TKit::DynamicArray<u32> &removals : m_Removals)
+            for (u32 &index : removals)
+                index = newIndices[index];
+        Core::GetArena().Reset();
+    }
+
+    // Cells now address particle ranges directly
+    for (u32 i = 0; i < order.size(); ++i)
+        order[i] = i;
+    Lookup.UpdateParticleCosts();
+    Lookup.InvalidateNeighborLists();
+    Lookup.InvalidatePairCache();
 }
-template <Dimension D> void Solver<D>::DrawParticles(Onyx::RenderContext<D> *p_Context) const noexcept
+
+template <Dimension D> SimulationState<D> Solver<D>::GetOrderedState() const noexcept
 {
-    Visualization<D>::DrawParticles(p_Context, Settings, Data.State);
+    // Ids are unique but not contiguous once particles have been removed, so the slots are sorted by them
+    const u32 count = GetParticleCount();
+    TKit::DynamicArray<u32> order(count);
+    for (u32 i = 0; i < count; ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [this](const u32 p_Left, const u32 p_Right) {
+        return Data.Ids[p_Left] < Data.Ids[p_Right];
+    });
+
+    SimulationState<D> state = Data.State.Clone();
+    for (u32 i = 0; i < count; ++i)
+    {
+        state.Positions[i] = Data.State.Positions[order[i]];
+        state.Velocities[i] = Data.State.Velocities[order[i]];
+    }
+    return state;
 }
 
 template <Dimension D> u32 Solver<D>::GetParticleCount() const noexcept
@@ -2,10 +2,54 @@
 
 #include "driz/simulation/settings.hpp"
 #include "driz/simulation/lookup.hpp"
-#include "onyx/rendering/render_context.hpp"
+#include "driz/simulation/shape.hpp"
+#include <span>
+#include <random>
 
 namespace Driz
 {
+struct TimestepStats
+{
+    u32 Substeps = 0;
+    f32 MinDeltaTime = 0.f;
+    f32 MaxDeltaTime = 0.f;
+    // Simulated time left uncovered once the substep limit was reached
+    f32 DroppedTime = 0.f;
+};
+
+// Parts of a step, in the order they run
+enum class StepPhase : u8
+{
+    BeginStep = 0,
+    UpdateLookup,
+    ComputeDensities,
+    // Pressure, viscosity and mouse forces
+    ComputeForces,
+    ApplyComputedForces,
+    EndStep
+};
+constexpr u32 StepPhaseCount = 6;
+
+const char *ToString(StepPhase p_Phase) noexcept;
+
+// Wall time spent in each phase of the last step. Phases that did not run are left at zero
+struct StepTimings
+{
+    TKit::Timespan &operator[](const StepPhase p_Phase) noexcept
+    {
+        return Phases[static_cast<u32>(p_Phase)];
+    }
+    const TKit::Timespan &operator[](const StepPhase p_Phase) const noexcept
+    {
+        return Phases[static_cast<u32>(p_Phase)];
+    }
+    TKit::Timespan GetTotal() const noexcept;
+
+    TKit::Array<TKit::Timespan, StepPhaseCount> Phases{};
+};
+
+class TelemetryRecorder;
+
 template <Dimension D> class Solver
 {
   public:
@@ -13,6 +57,57 @@ template <Dimension D> class Solver
 
     void BeginStep(f32 p_DeltaTime) noexcept;
     void EndStep() noexcept;
+    // Runs a whole step, from BeginStep to EndStep. The mouse force is applied around p_MousePos if it is not null
+    void Step(f32 p_DeltaTime, const fvec<D> *p_MousePos = nullptr) noexcept;
+
+    // Largest time step the CFL and force criteria allow, from the velocities and the accelerations of the last step
+    f32 ComputeStableTimestep() const noexcept;
+
+    // Covers p_FrameTime with calls to p_Step(deltaTime), which is expected to run a full step. Without an adaptive
+    // time step, this is a single call with the whole frame
+    template <typename F> const TimestepStats &Advance(const f32 p_FrameTime, F &&p_Step) noexcept
+    {
+        m_TimestepStats = TimestepStats{};
+        if (!Settings.AdaptiveTimestep)
+        {
+            recordSubstep(p_FrameTime);
+            std::forward<F>(p_Step)(p_FrameTime);
+            return m_TimestepStats;
+        }
+
+        // The frame is split into equal substeps instead of stable steps and a tiny last one. The amount left is an
+        // integer that only grows if the stable step shrinks mid frame, and the last substep takes whatever time is
+        // left, so rounding in the subtraction can never add a near zero substep at the end
+        f32 remaining = p_FrameTime;
+        u32 left = p_FrameTime > 0.f ? 1 : 0;
+        while (left > 0 && m_TimestepStats.Substeps < Settings.MaxSubsteps)
+        {
+            const f32 stable = ComputeStableTimestep();
+            const f32 needed = glm::min(glm::ceil(remaining / stable), static_cast<f32>(Settings.MaxSubsteps));
+            left = glm::max(left, static_cast<u32>(needed));
+
+            const f32 deltaTime = remaining / static_cast<f32>(left);
+            recordSubstep(deltaTime);
+            p_Step(deltaTime);
+            remaining = --left == 0 ? 0.f : remaining - deltaTime;
+        }
+        m_TimestepStats.DroppedTime = glm::max(remaining, 0.f);
+        return m_TimestepStats;
+    }
+    const TimestepStats &GetTimestepStats() const noexcept
+    {
+        return m_TimestepStats;
+    }
+    // Reset by every BeginStep, so that it covers the phases of the current or last step
+    const StepTimings &GetStepTimings() const noexcept
+    {
+        return m_StepTimings;
+    }
+    // Every EndStep records a sample to p_Telemetry, if not null. The recorder must outlive its use by the solver
+    void SetTelemetry(TelemetryRecorder *p_Telemetry) noexcept
+    {
+        m_Telemetry = p_Telemetry;
+    }
 
     void AddMouseForce(const fvec<D> &p_MousePos) noexcept;
     void AddPressureAndViscosity() noexcept;
@@ -20,85 +115,292 @@ template <Dimension D> class Solver
     void ApplyComputedForces(f32 p_DeltaTime) noexcept;
 
     u32 GetParticleCount() const noexcept;
+    // Worst relative interpolation error among the kernel tables currently in use
+    f32 GetKernelTableError() const noexcept;
+    // Pair-wise iteration is selected, but the lookup cannot color multithreaded passes, so they run particle-wise
+    bool IsPairWiseFallback() const noexcept;
+    SimulationState<D> GetOrderedState() const noexcept;
+    void SyncParticleData() noexcept;
 
     void UpdateLookup() noexcept;
     void UpdateAllLookups() noexcept;
 
     void AddParticle(const fvec<D> &p_Position) noexcept;
-
-    void DrawBoundingBox(Onyx::RenderContext<D> *p_Context) const noexcept;
-    void DrawParticles(Onyx::RenderContext<D> *p_Context) const noexcept;
+    // Appends all particles at once: storage grows a single time and the new entries are initialized in parallel
+    void AddParticles(std::span<const fvec<D>> p_Positions, const fvec<D> &p_Velocity = fvec<D>{0.f}) noexcept;
+    void AddParticles(const ParticleShape<D> &p_Shape) noexcept;
+    // Queues a particle for removal. Queued particles, along with the ones inside sinks, are removed when the step
+    // ends, so indices stay valid until then, and follow their particles if the step reorders them. Indices out of
+    // range are ignored. Must not be called from within a parallel pass
+    void RemoveParticle(u32 p_Index) noexcept;
 
     LookupMethod<D> Lookup;
     SimulationData<D> Data;
     SimulationSettings Settings;
 
   private:
-    // This is hilarious
-    template <typename F1, typename F2, typename F3, typename F4, typename F5, typename F6, typename F7, typename F8>
-    void forEachWithinSmoothingRadius(F1 &&p_BruteForcePairWiseST, F2 &&p_BruteForcePairWiseMT, F3 &&p_GridPairWiseST,
-                                      F4 &&p_GridPairWiseMT, F5 &&p_BruteForceParticleWiseST,
-                                      F6 &&p_BruteForceParticleWiseMT, F7 &&p_GridParticleWiseST,
-                                      F8 &&p_GridParticleWiseMT) const noexcept
-    {
-        switch (Settings.IterationMode)
+    // Pairs reach the kernels through small batches, so that the lookup traversals and the kernel math are
+    // instantiated independently. The latter is specialized for every kernel combination and selected once per pass
+    static constexpr u32 s_PairBatchSize = 256;
+
+    struct PairSpan
+    {
+        const u32 *Indices1;
+        const u32 *Indices2;
+        const f32 *SquaredDistances;
+        // Positions of the first particles relative to the second ones. Computed from the positions when null
+        const fvec<D> *Offsets;
+        u32 Size;
+    };
+
+    struct PairBatch
+    {
+        PairSpan GetSpan() const noexcept;
+
+        TKit::Array<u32, s_PairBatchSize> Indices1;
+        TKit::Array<u32, s_PairBatchSize> Indices2;
+        TKit::Array<f32, s_PairBatchSize> SquaredDistances;
+        u32 Size = 0;
+    };
+
+    // Slopes are tabulated divided by the distance, so that they can scale the raw offset between two particles
+    // instead of a normalized direction
+    struct KernelTables
+    {
+        KernelTable Influence;
+        KernelTable NearInfluence;
+        KernelTable InfluenceSlope;
+        KernelTable NearInfluenceSlope;
+        KernelTable Viscosity;
+
+        // What the tables were built for
+        f32 Radius = 0.f;
+        KernelType KType;
+        KernelType NearKType;
+        KernelType ViscosityKType;
+    };
+
+    // Symmetric accumulations write to both particles of a pair, one-sided ones only to the first
+    using DensityAccumulator = void (Solver::*)(const PairSpan &, SimArray<Density> &, bool) const noexcept;
+    using AccelerationAccumulator = void (Solver::*)(const PairSpan &, SimArray<fvec<D>> &, bool) const noexcept;
+
+    // Multithreaded pair-wise passes write to both particles of a pair, which is only safe with a colored traversal.
+    // Lookups that cannot be colored run those passes particle-wise instead, with each particle accumulating only its
+    // own contributions, so that no thread ever needs a private copy of the accumulators
+    bool usesColoring() const noexcept;
+
+    template <typename F1, typename F2, typename G>
+    void forEachPairWithinSmoothingRadius(F1 &&p_PairWiseST, F2 &&p_PairWiseMT, G &&p_Flush) const noexcept
+    {
+        switch (Settings.LookupMode)
+        {
+        case ParticleLookupMode::BruteForceSingleThread:
+        case ParticleLookupMode::BruteForceMultiThread:
+            Lookup.ForEachPairBruteForceST(std::forward<F1>(p_PairWiseST));
+            return;
+        case ParticleLookupMode::GridSingleThread:
+        case ParticleLookupMode::DenseGridSingleThread:
+            Lookup.ForEachPairGridST(std::forward<F1>(p_PairWiseST));
+            return;
+        case ParticleLookupMode::GridMultiThread:
+        case ParticleLookupMode::DenseGridMultiThread:
+            Lookup.ForEachPairGridColoredMT(std::forward<F2>(p_PairWiseMT), std::forward<G>(p_Flush));
+            return;
+        case ParticleLookupMode::VerletListSingleThread:
+            Lookup.ForEachPairVerletST(std::forward<F1>(p_PairWiseST));
+            return;
+        case ParticleLookupMode::VerletListMultiThread:
+            Lookup.ForEachPairVerletColoredMT(std::forward<F2>(p_PairWiseMT), std::forward<G>(p_Flush));
+            return;
+        }
+    }
+
+    template <typename F>
+    void forEachParticleWithinSmoothingRadius(const u32 p_Index, F &&p_Function) const noexcept
+    {
+        switch (Settings.LookupMode)
         {
-        case ParticleIterationMode::PairWise:
-            switch (Settings.LookupMode)
+        case ParticleLookupMode::BruteForceSingleThread:
+        case ParticleLookupMode::BruteForceMultiThread:
+            Lookup.ForEachParticleBruteForce(p_Index, std::forward<F>(p_Function));
+            return;
+        case ParticleLookupMode::GridSingleThread:
+        case ParticleLookupMode::GridMultiThread:
+        case ParticleLookupMode::DenseGridSingleThread:
+        case ParticleLookupMode::DenseGridMultiThread:
+            Lookup.ForEachParticleGrid(p_Index, std::forward<F>(p_Function));
+            return;
+        case ParticleLookupMode::VerletListSingleThread:
+        case ParticleLookupMode::VerletListMultiThread:
+            Lookup.ForEachParticleVerlet(p_Index, std::forward<F>(p_Function));
+            return;
+        }
+    }
+
+    template <typename F> void forEachParticle(F &&p_Function) const noexcept
+    {
+        forEachParticle(0, Data.State.Positions.size(), std::forward<F>(p_Function));
+    }
+    template <typename F> void forEachParticle(const u32 p_Start, const u32 p_End, F &&p_Function) const noexcept
+    {
+        if (Settings.UsesMultiThread())
+            Core::ForEach(p_Start, p_End, [&p_Function](const u32 p_ChunkStart, const u32 p_ChunkEnd, const u32) {
+                for (u32 i = p_ChunkStart; i < p_ChunkEnd; ++i)
+                    p_Function(i);
+            });
+        else
+            for (u32 i = p_Start; i < p_End; ++i)
+                p_Function(i);
+    }
+
+    template <typename F> void streamPairs(F &&p_Accumulate) noexcept
+    {
+        const auto flush = [this, &p_Accumulate](const u32, const u32 p_ThreadIndex) {
+            PairBatch &batch = m_PairBatches[p_ThreadIndex];
+            if (batch.Size != 0)
             {
-            case ParticleLookupMode::BruteForceSingleThread:
-                std::forward<F1>(p_BruteForcePairWiseST)();
-                return;
-            case ParticleLookupMode::BruteForceMultiThread:
-                std::forward<F2>(p_BruteForcePairWiseMT)();
-                return;
-            case ParticleLookupMode::GridSingleThread:
-                std::forward<F3>(p_GridPairWiseST)();
-                return;
-            case ParticleLookupMode::GridMultiThread:
-                std::forward<F4>(p_GridPairWiseMT)();
-                return;
+                p_Accumulate(batch.GetSpan());
+                batch.Size = 0;
             }
-            return;
-        case ParticleIterationMode::ParticleWise:
-            switch (Settings.LookupMode)
+        };
+        const auto push = [this, &p_Accumulate](const u32 p_Index1, const u32 p_Index2, const f32 p_Distance2,
+                                                const u32 p_ThreadIndex) {
+            PairBatch &batch = m_PairBatches[p_ThreadIndex];
+            batch.Indices1[batch.Size] = p_Index1;
+            batch.Indices2[batch.Size] = p_Index2;
+            batch.SquaredDistances[batch.Size] = p_Distance2;
+            if (++batch.Size == s_PairBatchSize)
             {
-            case ParticleLookupMode::BruteForceSingleThread:
-                std::forward<F5>(p_BruteForceParticleWiseST)();
-                return;
-            case ParticleLookupMode::BruteForceMultiThread:
-                std::forward<F6>(p_BruteForceParticleWiseMT)();
-                return;
-            case ParticleLookupMode::GridSingleThread:
-                std::forward<F7>(p_GridParticleWiseST)();
-                return;
-            case ParticleLookupMode::GridMultiThread:
-                std::forward<F8>(p_GridParticleWiseMT)();
-                return;
+                p_Accumulate(batch.GetSpan());
+                batch.Size = 0;
             }
+        };
+        forEachPairWithinSmoothingRadius(
+            [&push](const u32 p_Index1, const u32 p_Index2, const f32 p_Distance2) {
+                push(p_Index1, p_Index2, p_Distance2, 0);
+            },
+            push, flush);
+        flush(0, 0);
+    }
+
+    template <typename F> void streamCachedPairs(F &&p_Accumulate) const noexcept
+    {
+        if (Settings.UsesMultiThread())
+            Lookup.ForEachCachedSegmentColoredMT([&p_Accumulate](const PairCacheSegment<D> &p_Segment,
+                                                                 const u32 p_Begin, const u32 p_End, const u32) {
+                p_Accumulate(PairSpan{p_Segment.Indices1.data() + p_Begin, p_Segment.Indices2.data() + p_Begin,
+                                      p_Segment.SquaredDistances.data() + p_Begin, p_Segment.Offsets.data() + p_Begin,
+                                      p_End - p_Begin});
+            });
+        else
+            Lookup.ForEachCachedSegmentST([&p_Accumulate](const PairCacheSegment<D> &p_Segment) {
+                p_Accumulate(PairSpan{p_Segment.Indices1.data(), p_Segment.Indices2.data(),
+                                      p_Segment.SquaredDistances.data(), p_Segment.Offsets.data(),
+                                      static_cast<u32>(p_Segment.SquaredDistances.size())});
+            });
+    }
+
+    // Particle-wise passes vary wildly in cost from one particle to another, so they are balanced with the work
+    // estimates of the lookup whenever there are some
+    template <typename F> void forEachNeighborhood(F &&p_Function) const noexcept
+    {
+        const auto process = [&p_Function](const u32 p_Start, const u32 p_End, const u32) {
+            for (u32 i = p_Start; i < p_End; ++i)
+                p_Function(i);
+        };
+        const u32 particles = Data.State.Positions.size();
+        switch (Settings.LookupMode)
+        {
+        case ParticleLookupMode::BruteForceSingleThread:
+        case ParticleLookupMode::GridSingleThread:
+        case ParticleLookupMode::DenseGridSingleThread:
+        case ParticleLookupMode::VerletListSingleThread:
+            process(0, particles, 0);
+            return;
+        case ParticleLookupMode::BruteForceMultiThread:
+            Core::ForEach(0, particles, process);
+            return;
+        case ParticleLookupMode::GridMultiThread:
+        case ParticleLookupMode::DenseGridMultiThread:
+            Core::ForEachWeighted(0, particles, Lookup.GetParticleCosts(), process);
+            return;
+        case ParticleLookupMode::VerletListMultiThread:
+            Core::ForEachWeighted(0, particles, Lookup.Verlet.Offsets.data(), process);
             return;
         }
     }
 
+    template <typename F> void streamNeighbors(F &&p_Accumulate) const noexcept
+    {
+        forEachNeighborhood([this, &p_Accumulate](const u32 p_Index) {
+            PairBatch batch;
+            forEachParticleWithinSmoothingRadius(
+                p_Index, [p_Index, &batch, &p_Accumulate](const u32 p_Index2, const f32 p_Distance2) {
+                    batch.Indices1[batch.Size] = p_Index;
+                    batch.Indices2[batch.Size] = p_Index2;
+                    batch.SquaredDistances[batch.Size] = p_Distance2;
+                    if (++batch.Size == s_PairBatchSize)
+                    {
+                        p_Accumulate(batch.GetSpan());
+                        batch.Size = 0;
+                    }
+                });
+            if (batch.Size != 0)
+                p_Accumulate(batch.GetSpan());
+        });
+    }
+
+    // Spans may be longer than a batch, such as whole cached segments, and are split into batches to gather distances
+    static void gatherDistances(const PairSpan &p_Pairs, u32 p_Start, u32 p_Size, f32 *p_Distances) noexcept;
+
+    template <KernelType K, KernelType NK>
+    void accumulateDensities(const PairSpan &p_Pairs, SimArray<Density> &p_Densities,
+                             bool p_Symmetric) const noexcept;
+    template <KernelType K, KernelType NK, KernelType VK>
+    void accumulateAccelerations(const PairSpan &p_Pairs, SimArray<fvec<D>> &p_Accelerations,
+                                 bool p_Symmetric) const noexcept;
+
+    void accumulateTabulatedDensities(const PairSpan &p_Pairs, SimArray<Density> &p_Densities,
+                                      bool p_Symmetric) const noexcept;
+    void accumulateTabulatedAccelerations(const PairSpan &p_Pairs, SimArray<fvec<D>> &p_Accelerations,
+                                          bool p_Symmetric) const noexcept;
+
+    void updateKernelTables() noexcept;
+
     fvec2 getPressureFromDensity(const Density &p_Density) const noexcept;
 
     void encase(u32 p_Index) noexcept;
+    void reorderParticlesIfDue() noexcept;
 
-    void mergeDensityArrays() noexcept;
-    void mergeAccelerationArrays() noexcept;
-
-    f32 getInfluence(f32 p_Distance) const noexcept;
-    f32 getInfluenceSlope(f32 p_Distance) const noexcept;
+    void recordSubstep(f32 p_DeltaTime) noexcept;
+    void queueSinkRemovals() noexcept;
+    void removeQueuedParticles() noexcept;
+    void runEmitters(f32 p_DeltaTime) noexcept;
+    void firstTouchParticleData(u32 p_Count) noexcept;
 
-    f32 getNearInfluence(f32 p_Distance) const noexcept;
-    f32 getNearInfluenceSlope(f32 p_Distance) const noexcept;
+    fvec<D> computePairwisePressureGradient(u32 p_Index1, u32 p_Index2, const fvec2 &p_Slopes,
+                                            const fvec<D> &p_Direction) const noexcept;
+    fvec<D> computePairwiseViscosityTerm(u32 p_Index1, u32 p_Index2, f32 p_Kernel) const noexcept;
 
-    f32 getViscosityInfluence(f32 p_Distance) const noexcept;
+    TKit::Array<PairBatch, TKIT_THREAD_POOL_MAX_THREADS> m_PairBatches;
+    KernelParameters m_KernelParameters;
+    KernelTables m_KernelTables;
 
-    fvec<D> computePairwisePressureGradient(u32 p_Index1, u32 p_Index2, f32 p_Distance) const noexcept;
-    fvec<D> computePairwiseViscosityTerm(u32 p_Index1, u32 p_Index2, f32 p_Distance) const noexcept;
+    // Particles to remove at the end of the step, one list per thread so that sinks can be checked in parallel
+    TKit::Array<TKit::DynamicArray<u32>, TKIT_THREAD_POOL_MAX_THREADS> m_Removals;
+    // Fractional particles owed by each emitter, carried over between steps. Budgets belong to emitter slots, so they
+    // are reset whenever the amount of emitters changes
+    TKit::Array<f32, MaxFlowVolumes> m_EmissionBudgets{};
+    u32 m_BudgetedEmitters = 0;
+    std::minstd_rand m_Random{};
 
-    TKit::Array<SimArray<fvec<D>>, TKIT_THREAD_POOL_MAX_THREADS> m_ThreadAccelerations;
-    TKit::Array<SimArray<Density>, TKIT_THREAD_POOL_MAX_THREADS> m_ThreadDensities;
+    TimestepStats m_TimestepStats{};
+    StepTimings m_StepTimings{};
+    TelemetryRecorder *m_Telemetry = nullptr;
+    u32 m_StepsSinceReorder = 0;
+    u32 m_NextId = 0;
+    f32 m_StepDeltaTime = 0.f;
+    // Time step the current positions were predicted for by ApplyComputedForces, or 0 if there is no prediction
+    f32 m_PredictionDeltaTime = 0.f;
 };
 } // namespace Driz
\ No newline at end of file
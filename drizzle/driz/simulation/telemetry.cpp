@@ -0,0 +1,131 @@
+#include "driz/simulation/telemetry.hpp"
+#include "tkit/profiling/macros.hpp"
+#include <chrono>
+
+namespace Driz
+{
+static constexpr const char *s_LookupColumns[] = {"Sort", "Merge", "Build", "NeighborLists"};
+static constexpr f32 s_MinFlushInterval = 0.001f;
+
+static bool isJsonPath(const std::string &p_Path) noexcept
+{
+    const auto endsWith = [&p_Path](const std::string &p_Suffix) {
+        return p_Path.size() >= p_Suffix.size() &&
+               p_Path.compare(p_Path.size() - p_Suffix.size(), p_Suffix.size(), p_Suffix) == 0;
+    };
+    return endsWith(".json") || endsWith(".jsonl");
+}
+
+TelemetryRecorder::TelemetryRecorder(const TelemetrySettings &p_Settings) noexcept
+    : m_Settings(p_Settings), m_File(p_Settings.Path), m_Json(isJsonPath(p_Settings.Path))
+{
+    if (!m_File)
+        return;
+    if (!m_Json)
+        writeHeader();
+    m_Thread = std::thread([this]() { run(); });
+}
+TelemetryRecorder::~TelemetryRecorder() noexcept
+{
+    if (!m_Thread.joinable())
+        return;
+    m_Stop.store(true, std::memory_order_release);
+    m_Thread.join();
+}
+
+bool TelemetryRecorder::IsOpen() const noexcept
+{
+    return m_Thread.joinable();
+}
+bool TelemetryRecorder::ShouldCountClashes() const noexcept
+{
+    return m_Settings.ClashInterval != 0 && m_Steps % m_Settings.ClashInterval == 0;
+}
+
+void TelemetryRecorder::Record(TelemetrySample &p_Sample) noexcept
+{
+    p_Sample.Step = m_Steps++;
+    p_Sample.Time = static_cast<f64>(m_Clock.GetElapsed().AsSeconds());
+    if (!m_Samples.Push(p_Sample))
+        m_Dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+u64 TelemetryRecorder::GetRecordedCount() const noexcept
+{
+    return m_Steps;
+}
+u64 TelemetryRecorder::GetDroppedCount() const noexcept
+{
+    return m_Dropped.load(std::memory_order_relaxed);
+}
+
+// The writer sleeps between flushes instead of waiting on the producer, so that recording is a plain push
+void TelemetryRecorder::run() noexcept
+{
+    // Non-positive or NaN intervals would make the sleep return at once and the writer spin on a core
+    const f32 seconds = m_Settings.FlushInterval > s_MinFlushInterval ? m_Settings.FlushInterval : s_MinFlushInterval;
+    const auto interval = std::chrono::duration<f32>(seconds);
+    while (!m_Stop.load(std::memory_order_acquire))
+    {
+        std::this_thread::sleep_for(interval);
+        flush();
+    }
+    flush();
+}
+
+void TelemetryRecorder::flush() noexcept
+{
+    TKIT_PROFILE_NSCOPE("Driz::TelemetryRecorder::Flush");
+    TelemetrySample sample;
+    while (m_Samples.Pop(sample))
+        write(sample);
+    m_File.flush();
+}
+
+void TelemetryRecorder::writeHeader() noexcept
+{
+    m_File << "step,time,particles,cells,pairs,cell_clashes";
+    for (u32 i = 0; i < StepPhaseCount; ++i)
+        m_File << ',' << ToString(static_cast<StepPhase>(i)) << "_ms";
+    for (const char *column : s_LookupColumns)
+        m_File << ",Lookup" << column << "_ms";
+    m_File << ",Step_ms\n";
+}
+
+void TelemetryRecorder::write(const TelemetrySample &p_Sample) noexcept
+{
+    const TKit::Timespan lookup[] = {p_Sample.Lookup.Sort, p_Sample.Lookup.Merge, p_Sample.Lookup.Build,
+                                     p_Sample.Lookup.NeighborLists};
+    const bool clashes = p_Sample.CellClashes != UINT32_MAX;
+    if (!m_Json)
+    {
+        m_File << p_Sample.Step << ',' << p_Sample.Time << ',' << p_Sample.Particles << ',' << p_Sample.Cells << ','
+               << p_Sample.Pairs << ',';
+        if (clashes)
+            m_File << p_Sample.CellClashes;
+        for (const TKit::Timespan &time : p_Sample.Timings.Phases)
+            m_File << ',' << time.AsMilliseconds();
+        for (const TKit::Timespan &time : lookup)
+            m_File << ',' << time.AsMilliseconds();
+        m_File << ',' << p_Sample.Timings.GetTotal().AsMilliseconds() << '\n';
+        return;
+    }
+
+    m_File << "{\"step\": " << p_Sample.Step << ", \"time\": " << p_Sample.Time
+           << ", \"particles\": " << p_Sample.Particles << ", \"cells\": " << p_Sample.Cells
+           << ", \"pairs\": " << p_Sample.Pairs << ", \"cell_clashes\": ";
+    if (clashes)
+        m_File << p_Sample.CellClashes;
+    else
+        m_File << "null";
+
+    m_File << ", \"phases_ms\": {";
+    for (u32 i = 0; i < StepPhaseCount; ++i)
+        m_File << (i == 0 ? "\"" : ", \"") << ToString(static_cast<StepPhase>(i))
+               << "\": " << p_Sample.Timings.Phases[i].AsMilliseconds();
+    m_File << "}, \"lookup_ms\": {";
+    for (u32 i = 0; i < 4; ++i)
+        m_File << (i == 0 ? "\"" : ", \"") << s_LookupColumns[i] << "\": " << lookup[i].AsMilliseconds();
+    m_File << "}, \"step_ms\": " << p_Sample.Timings.GetTotal().AsMilliseconds() << "}\n";
+}
+} // namespace Driz
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "driz/simulation/solver.hpp"
+#include "driz/core/spsc_queue.hpp"
+#include <fstream>
+#include <string>
+#include <thread>
+
+namespace Driz
+{
+// Everything recorded about a single step
+struct TelemetrySample
+{
+    StepTimings Timings{};
+    LookupTimings Lookup{};
+    u64 Step = 0;
+    // Seconds since the recorder was created
+    f64 Time = 0.0;
+    u32 Particles = 0;
+    // Zero if the lookup mode uses no grid
+    u32 Cells = 0;
+    // Pairs cached by the density pass, zero if pairs were not cached
+    u32 Pairs = 0;
+    // UINT32_MAX on the steps where clashes were not counted
+    u32 CellClashes = UINT32_MAX;
+};
+
+struct TelemetrySettings
+{
+    // A CSV file, or a JSON Lines one if the path ends with .json or .jsonl
+    std::string Path;
+    // Seconds between flushes of the buffer to the file. Clamped to at least a millisecond so the writer never spins
+    f32 FlushInterval = 0.1f;
+    // Cell clashes cost a pass over every particle, so they are only counted once every this many steps
+    u32 ClashInterval = 64;
+};
+
+// Always-on recording of per-step telemetry. The stepping thread pushes one sample per step into a lock-free ring
+// buffer, and a background thread periodically drains it into the file. Recording never blocks the simulation:
+// samples that find the buffer full are dropped and counted. The buffer is large, so recorders belong on the heap
+class TelemetryRecorder
+{
+  public:
+    explicit TelemetryRecorder(const TelemetrySettings &p_Settings) noexcept;
+    // Writes every sample still in the buffer before returning
+    ~TelemetryRecorder() noexcept;
+
+    TelemetryRecorder(const TelemetryRecorder &) = delete;
+    TelemetryRecorder &operator=(const TelemetryRecorder &) = delete;
+
+    bool IsOpen() const noexcept;
+    // Whether the step about to be recorded should count cell clashes
+    bool ShouldCountClashes() const noexcept;
+
+    // Must always be called from the same thread, or at least never from two at once. Assigns the step and time
+    void Record(TelemetrySample &p_Sample) noexcept;
+
+    u64 GetRecordedCount() const noexcept;
+    u64 GetDroppedCount() const noexcept;
+
+  private:
+    static constexpr u32 s_Capacity = 4096;
+
+    void run() noexcept;
+    void flush() noexcept;
+    void writeHeader() noexcept;
+    void write(const TelemetrySample &p_Sample) noexcept;
+
+    TelemetrySettings m_Settings;
+    std::ofstream m_File;
+    std::thread m_Thread;
+    std::atomic<bool> m_Stop{false};
+
+    SpscQueue<TelemetrySample, s_Capacity> m_Samples;
+    std::atomic<u64> m_Dropped{0};
+    TKit::Clock m_Clock{};
+    bool m_Json = false;
+
+    // Owned by the recording thread
+    u64 m_Steps = 0;
+};
+} // namespace Driz
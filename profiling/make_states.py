@@ -0,0 +1,80 @@
+from argparse import ArgumentParser, Namespace
+from pathlib import Path
+
+
+def parse_arguments() -> Namespace:
+    desc = """
+    This python script writes the fixed set of simulation states the regression gate runs on. States are lattices at
+    the rest spacing of the default settings, so that they are reproducible without running the simulation.
+    """
+    parser = ArgumentParser(description=desc)
+    parser.add_argument(
+        "-o",
+        "--output",
+        type=Path,
+        default=Path(__file__).parent / "states",
+        help="The folder where the '2D' and '3D' state folders are written. Default is '<root>/profiling/states'.",
+    )
+    return parser.parse_args()
+
+
+# Same spacing as the synthetic layouts of drizzle-bench: 0.4 smoothing radii, the default radius being 1
+SPACING = 0.4
+
+
+def lattice(counts: list[int], origin: list[float]) -> list[list[float]]:
+    points = [[]]
+    for axis, count in enumerate(counts):
+        points = [
+            point + [origin[axis] + SPACING * i] for point in points for i in range(count)
+        ]
+    return points
+
+
+def vector(values: list[float]) -> str:
+    return "[" + ", ".join(f"{value:g}" for value in values) + "]"
+
+
+def write_state(
+    path: Path, positions: list[list[float]], bmin: list[float], bmax: list[float]
+) -> None:
+    dim = len(bmin)
+    lines = ["Positions:"]
+    lines += [f"  - {vector(position)}" for position in positions]
+    lines.append("Velocities:")
+    lines += [f"  - {vector([0.0] * dim)}" for _ in positions]
+    lines.append(f"Min: {vector(bmin)}")
+    lines.append(f"Max: {vector(bmax)}")
+
+    path.parent.mkdir(exist_ok=True, parents=True)
+    path.write_text("\n".join(lines) + "\n")
+
+
+def main() -> None:
+    args = parse_arguments()
+
+    # A centered block at rest and a dam break in the corner of a box three times as wide
+    for dim, side in ((2, 50), (3, 16)):
+        folder = args.output / f"{dim}D"
+        half = 0.5 * SPACING * side
+        write_state(
+            folder / "block.yaml",
+            lattice([side] * dim, [-half] * dim),
+            [-half - SPACING] * dim,
+            [half + SPACING] * dim,
+        )
+
+        extent = SPACING * side
+        counts = [side // 2] + [side] * (dim - 1)
+        bmin = [-extent] * dim
+        bmax = [2.0 * extent] + [extent] * (dim - 1)
+        write_state(
+            folder / "dam-break.yaml",
+            lattice(counts, [value + 0.5 * SPACING for value in bmin]),
+            bmin,
+            bmax,
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,225 @@
+from argparse import ArgumentParser, Namespace
+from pathlib import Path
+
+import json
+import math
+import statistics
+import subprocess
+import sys
+import tempfile
+
+
+def parse_arguments() -> tuple[Namespace, list[str]]:
+    desc = """
+    This python script runs every state in the '2D' and '3D' folders of the fixture directory through
+    'drizzle-headless' for a fixed amount of steps, aggregates the time spent in each step phase over several repetitions and compares the results
+    against a baseline. It exits with code 1 if any phase got slower beyond both the relative threshold and
+    the measurement noise, and with code 2 if some state has no baseline measurements to compare against, so an
+    unrecorded baseline is never read as a pass. Unknown arguments are forwarded to 'drizzle-headless', so settings such as '--settings' or
+    '--threads' can be fixed for every run.
+    """
+    parser = ArgumentParser(description=desc)
+    root = Path(__file__).parent.parent
+    parser.add_argument(
+        "--headless-exec",
+        type=Path,
+        default=root / "build" / "drizzle" / "drizzle-headless",
+        help="The path to the 'drizzle-headless' executable. Default is '<root>/build/drizzle/drizzle-headless'.",
+    )
+    parser.add_argument(
+        "--states",
+        type=Path,
+        default=Path(__file__).parent / "states",
+        help="The folder holding the '2D' and '3D' state folders. Default is the checked-in fixtures in "
+        "'<root>/profiling/states', written by 'make_states.py'. Point it to '<root>/saves' to gate on saved states.",
+    )
+    parser.add_argument(
+        "-b",
+        "--baseline",
+        type=Path,
+        default=Path(__file__).parent / "baseline.json",
+        help="The path to the baseline JSON. Default is '<root>/profiling/baseline.json'.",
+    )
+    parser.add_argument(
+        "-u",
+        "--update-baseline",
+        action="store_true",
+        default=False,
+        help="Write the measured timings as the new baseline instead of comparing against it.",
+    )
+    parser.add_argument(
+        "-n", "--steps", type=int, default=200, help="The amount of steps measured per run."
+    )
+    parser.add_argument(
+        "--warmup-steps",
+        type=int,
+        default=20,
+        help="The amount of steps run before the measured ones.",
+    )
+    parser.add_argument(
+        "-r",
+        "--repeats",
+        type=int,
+        default=5,
+        help="The amount of times each state is run. The median of the runs is compared.",
+    )
+    parser.add_argument(
+        "-t",
+        "--threshold",
+        type=float,
+        default=0.05,
+        help="The relative slowdown a phase may show before it is considered a regression.",
+    )
+    parser.add_argument(
+        "--sigmas",
+        type=float,
+        default=3.0,
+        help="The amount of combined standard deviations a slowdown must exceed to not be attributed to noise.",
+    )
+    parser.add_argument(
+        "--min-ms",
+        type=float,
+        default=0.01,
+        help="Phases whose baseline time is below this amount of milliseconds are not checked.",
+    )
+    parser.add_argument(
+        "-v",
+        "--verbose",
+        action="store_true",
+        default=False,
+        help="Print more information.",
+    )
+
+    return parser.parse_known_args()
+
+
+def find_states(root: Path) -> list[tuple[str, Path]]:
+    states = []
+    for dim in ("2D", "3D"):
+        folder = root / dim
+        if folder.is_dir():
+            states.extend(
+                (f"{dim}/{path.stem}", path) for path in sorted(folder.glob("*.yaml"))
+            )
+    return states
+
+
+def run_state(
+    args: Namespace, unknown: list[str], name: str, state: Path, log
+) -> dict[str, dict[str, float]]:
+    # Each run reports its median time per substep for each phase. Runs are then summarized by their median and spread
+    runs: dict[str, list[float]] = {}
+    dim_flag = "--2-dim" if name.startswith("2D") else "--3-dim"
+    with tempfile.TemporaryDirectory() as folder:
+        output = Path(folder) / "timings.json"
+        for i in range(args.repeats):
+            command = [
+                str(args.headless_exec),
+                dim_flag,
+                "--state",
+                str(state),
+                "--steps",
+                str(args.steps),
+                "--warmup-steps",
+                str(args.warmup_steps),
+                "--timings",
+                str(output),
+            ] + unknown
+
+            log(f"Executing drizzle-headless ({i + 1}/{args.repeats}): {' '.join(command)}")
+            subprocess.run(command, check=True, stdout=subprocess.DEVNULL)
+            with output.open() as f:
+                timings = json.load(f)
+            for phase, stats in timings["phases"].items():
+                runs.setdefault(phase, []).append(stats["median_ms"])
+
+    return {
+        phase: {
+            "median_ms": statistics.median(samples),
+            "stddev_ms": statistics.stdev(samples) if len(samples) > 1 else 0.0,
+        }
+        for phase, samples in runs.items()
+    }
+
+
+def compare(
+    args: Namespace,
+    baseline: dict[str, dict[str, dict[str, float]]],
+    results: dict[str, dict[str, dict[str, float]]],
+) -> tuple[bool, bool]:
+    regressed = False
+    unmeasured = False
+    print(f"{'State':<24}{'Phase':<22}{'Base ms':>10}{'Now ms':>10}{'Change':>9}  Verdict")
+    for name, phases in results.items():
+        if name not in baseline:
+            print(f"{name:<24}not in the baseline, run with '--update-baseline' to record it")
+            unmeasured = True
+            continue
+        # States are listed with no measurements until the baseline is first recorded on the reference machine
+        if baseline[name] is None:
+            print(f"{name:<24}not measured in the baseline yet, run with '--update-baseline' to record it")
+            unmeasured = True
+            continue
+
+        for phase, current in phases.items():
+            base = baseline[name].get(phase)
+            if base is None or base["median_ms"] < args.min_ms:
+                continue
+
+            delta = current["median_ms"] - base["median_ms"]
+            noise = args.sigmas * math.hypot(base["stddev_ms"], current["stddev_ms"])
+            change = delta / base["median_ms"]
+
+            # A phase regresses when it is both meaningfully and significantly slower
+            verdict = "ok"
+            if change > args.threshold and delta > noise:
+                verdict = "REGRESSION"
+                regressed = True
+            elif -change > args.threshold and -delta > noise:
+                verdict = "faster"
+            print(
+                f"{name:<24}{phase:<22}{base['median_ms']:>10.4f}{current['median_ms']:>10.4f}{change:>+9.1%}  {verdict}"
+            )
+
+    for name in baseline:
+        if name not in results:
+            print(f"{name:<24}in the baseline but not found in the states")
+    return regressed, unmeasured
+
+
+def main() -> None:
+    args, unknown = parse_arguments()
+
+    def log(*pargs, **kwargs) -> None:
+        if args.verbose:
+            print(*pargs, **kwargs)
+
+    states = find_states(args.states)
+    if not states:
+        print(f"No states found in '{args.states / '2D'}' or '{args.states / '3D'}'")
+        sys.exit(1)
+
+    results = {name: run_state(args, unknown, name, state, log) for name, state in states}
+    if args.update_baseline:
+        args.baseline.parent.mkdir(exist_ok=True, parents=True)
+        with args.baseline.open("w") as f:
+            json.dump(results, f, indent=2)
+        print(f"Baseline with {len(results)} states written to '{args.baseline}'")
+        return
+
+    if not args.baseline.exists():
+        print(f"Baseline '{args.baseline}' not found. Create it with '--update-baseline'")
+        sys.exit(1)
+
+    with args.baseline.open() as f:
+        baseline = json.load(f)
+    regressed, unmeasured = compare(args, baseline, results)
+    if regressed:
+        sys.exit(1)
+    if unmeasured:
+        print("Some states could not be compared, the gate did not pass")
+        sys.exit(2)
+
+
+if __name__ == "__main__":
+    main()